@@ -0,0 +1,78 @@
+#ifndef CS3210_ASSIGNMENT1_ARENA_H
+#define CS3210_ASSIGNMENT1_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#define CACHE_LINE_SIZE 64
+
+/* Bump allocator for simulation objects.
+ *
+ * Objects are packed back to back into large cache-line aligned blocks, so objects created together
+ * (a station and its platforms, consecutive trains) end up next to each other in memory. Nothing is
+ * freed individually: the destructor runs the destructors of every non-trivial object in reverse order
+ * and releases the blocks in one go. */
+class Arena {
+public:
+    explicit Arena(size_t block_size = 1 << 20) {
+        this->block_size = block_size;
+        this->cur = nullptr;
+        this->left = 0;
+    }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        for (size_t i = this->finalizers.size(); i-- > 0;) {
+            this->finalizers[i].destroy(this->finalizers[i].obj);
+        }
+        for (void *block: this->blocks) free(block);
+    }
+
+    void *allocate(size_t size, size_t align) {
+        size_t pad = (align - (uintptr_t)this->cur % align) % align;
+        if (this->cur == nullptr || pad + size > this->left) {
+            size_t bytes = size + align > this->block_size ? size + align : this->block_size;
+            bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+            this->cur = (char *)aligned_alloc(CACHE_LINE_SIZE, bytes);
+            if (this->cur == nullptr) throw bad_alloc();
+            this->blocks.push_back(this->cur);
+            this->left = bytes;
+            pad = (align - (uintptr_t)this->cur % align) % align;
+        }
+        void *p = this->cur + pad;
+        this->cur += pad + size;
+        this->left -= pad + size;
+        return p;
+    }
+
+    template<typename T, typename... Args>
+    T *create(Args&&... args) {
+        T *obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!is_trivially_destructible<T>::value) {
+            this->finalizers.push_back({obj, [](void *p) { static_cast<T *>(p)->~T(); }});
+        }
+        return obj;
+    }
+
+private:
+    struct Finalizer {
+        void *obj;
+        void (*destroy)(void *);
+    };
+
+    size_t block_size;
+    char *cur;                          // next free byte of the current block
+    size_t left;                        // bytes left in the current block
+    vector<void *> blocks;
+    vector<Finalizer> finalizers;
+};
+
+#endif //CS3210_ASSIGNMENT1_ARENA_H
@@ -0,0 +1,77 @@
+#ifndef CS3210_ASSIGNMENT1_BATCH_H
+#define CS3210_ASSIGNMENT1_BATCH_H
+
+#include "soa_run.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+
+/* Runs many scenarios over one loaded network.
+ *
+ * The network and its SoATopology are built once and only read afterwards; every job gets its own
+ * SoAEngine (the per-train and per-platform arrays) and writes its tick lines to <out_dir>/job<i>.out.
+ * Jobs are spread over a work-stealing pool, so long and short scenarios can be mixed freely. */
+
+struct BatchJob {
+    size_t ticks;
+    vector<size_t> num_trains;          // per line
+    size_t num_lines;
+    double seconds;                     // wall time of the run, filled in by runBatch
+    bool ok;
+    int write_error;                    // errno when the output was opened but not fully written
+};
+
+// One job per line: N, one train count per network line, then the number of printed lines
+// ("N g y b num_lines" for the assignment networks). Blank lines and lines starting with '#' are skipped.
+bool loadBatchJobs(const string &path, unsigned network_lines, vector<BatchJob> &jobs) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    string text;
+    for (unsigned line_no = 1; getline(in, text); ++line_no) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string::npos || text[first] == '#') continue;
+        istringstream fields(text);
+        vector<size_t> values;
+        size_t v;
+        while (fields >> v) values.push_back(v);
+        if (!fields.eof() || values.size() != network_lines + 2) {
+            cerr << path << ':' << line_no << ": expected N, " << network_lines << " train counts and num_lines\n";
+            return false;
+        }
+        BatchJob job = {};
+        job.ticks = values.front();
+        job.num_trains.assign(values.begin() + 1, values.end() - 1);
+        job.num_lines = values.back();
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+void runBatch(const Network &network, vector<BatchJob> &jobs, const string &out_dir, unsigned num_threads) {
+    const SoATopology topo(network);
+    const SoARunOptions opts;
+    WorkStealingPool pool(min<size_t>(num_threads, jobs.size()));
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        pool.submit([&, i] {
+            BatchJob &job = jobs[i];
+            string path = out_dir + "/job" + to_string(i) + ".out";
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            job.ok = fd >= 0;
+            if (!job.ok) return;
+            auto before = chrono::steady_clock::now();
+            job.write_error = runSoA(network, topo, job.ticks, job.num_trains, job.num_lines, opts, fd);
+            job.ok = job.write_error == 0;
+            job.seconds = chrono::duration<double>(chrono::steady_clock::now() - before).count();
+            close(fd);
+        });
+    }
+    pool.run();
+}
+
+#endif //CS3210_ASSIGNMENT1_BATCH_H
@@ -0,0 +1,82 @@
+#ifndef CS3210_ASSIGNMENT1_BENCH_H
+#define CS3210_ASSIGNMENT1_BENCH_H
+
+#include "main.h"
+#include "netgen.h"
+#include "profile.h"
+#include <functional>
+
+/* Throughput benchmark over generated networks.
+ *
+ * For every (station count, trains per line) pair of the grid a network is generated in memory, built
+ * and simulated with nothing printed, so the time is spent in the engine alone. Throughput is reported
+ * as train-ticks per second: trains on the network summed over the simulated ticks. */
+
+struct BenchOptions {
+    vector<size_t> stations = {100, 1000, 10000};
+    vector<size_t> trains = {10, 100, 1000};       // per line
+    size_t network_lines = 3;
+    size_t ticks = 10000;
+    uint64_t seed = 1;
+};
+
+// "a,b,c"
+inline bool parseSizeList(const char *text, vector<size_t> &values) {
+    values.clear();
+    while (*text != '\0') {
+        char *end;
+        unsigned long long v = strtoull(text, &end, 10);
+        if (end == text || (*end != ',' && *end != '\0')) return false;
+        values.push_back(v);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+// trains running during each tick summed over the run, with the spawning rule of simulate()
+inline uint64_t trainTicks(const vector<size_t> &wanted, size_t ticks) {
+    uint64_t total = 0;
+    for (size_t n: wanted) {
+        for (size_t t = 0; t < ticks; ++t) {
+            size_t running = min(n, 2 * (t + 1));
+            total += running;
+            if (running == n) {
+                total += (uint64_t)n * (ticks - t - 1);
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+// run simulates a built network with the spec's tick and train counts
+void runBenchmark(const BenchOptions &opts, const function<void(Network &, const NetworkSpec &)> &run) {
+    printf("%10s %8s %10s %10s %12s %16s\n", "stations", "lines", "trains", "ticks", "seconds", "train_ticks/s");
+    for (size_t S: opts.stations) {
+        for (size_t T: opts.trains) {
+            GeneratorParams params;
+            params.num_stations = S;
+            params.num_network_lines = opts.network_lines;
+            params.min_line_length = max<size_t>(S / 10, 2);
+            params.max_line_length = max<size_t>(S / 5, 2);
+            params.shared_segments = 2 * opts.network_lines;
+            params.trains_per_line = T;
+            params.ticks = opts.ticks;
+            params.num_lines = 0;
+            params.seed = opts.seed;
+            NetworkSpec spec;
+            NetworkGenerator(params).generate(spec);
+
+            Network network;
+            network.build(spec);
+            uint64_t before = monotonicNanos();
+            run(network, spec);
+            double seconds = (monotonicNanos() - before) / 1e9;
+            printf("%10zu %8zu %10zu %10zu %12.6f %16.0f\n", S, opts.network_lines, T, opts.ticks, seconds,
+                   trainTicks(spec.num_trains, spec.ticks) / max(seconds, 1e-9));
+            fflush(stdout);
+        }
+    }
+}
+
+#endif //CS3210_ASSIGNMENT1_BENCH_H
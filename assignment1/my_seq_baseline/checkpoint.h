@@ -0,0 +1,99 @@
+#ifndef CS3210_ASSIGNMENT1_CHECKPOINT_H
+#define CS3210_ASSIGNMENT1_CHECKPOINT_H
+
+#include "soa_engine.h"
+#include <algorithm>
+#include <cstdio>
+
+/* Binary snapshot of a SoAEngine run.
+ *
+ * Layout (native byte order):
+ *   CheckpointHeader
+ *   train count of every line                         (uint64 each)
+ *   next train id, number of trains, spawned per line (uint64 each)
+ *   per train: status, route, station_at, load_count, travel_count, queue_next, line, train_id
+ *   per platform / link: platform_occupied, link_occupied, queue_head, queue_tail
+ * The header pins the network shape and train counts, so a checkpoint is only resumed against the
+ * input it was taken from. Resuming at the stored tick prints exactly what the uninterrupted run
+ * prints from that tick on. */
+
+#define CHECKPOINT_MAGIC "MRTCKPT"
+#define CHECKPOINT_VERSION 2
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_stations;
+    uint32_t num_links;
+    uint32_t num_routes;
+    uint32_t num_lines;
+    uint64_t tick;                      // ticks already simulated
+};
+
+inline void fillCheckpointHeader(CheckpointHeader &h, const SoATopology &topo, uint64_t tick) {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    h.version = CHECKPOINT_VERSION;
+    h.num_stations = topo.station_popularity.size();
+    h.num_links = topo.link_distance.size();
+    h.num_routes = topo.route_station.size();
+    h.num_lines = topo.numLines();
+    h.tick = tick;
+}
+
+// Written to a temporary file first, so a crash while saving never leaves a torn checkpoint behind.
+bool saveCheckpoint(const string &path, const SoAEngine &engine, const SoATopology &topo, uint64_t tick,
+                    const vector<size_t> &wanted) {
+    string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        cerr << "Failed to open " << tmp << '\n';
+        return false;
+    }
+    CheckpointHeader h;
+    fillCheckpointHeader(h, topo, tick);
+    vector<uint64_t> counts(wanted.begin(), wanted.end());
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && writeArray(f, counts) && engine.writeState(f);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "Failed to write checkpoint " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(const string &path, SoAEngine &engine, const SoATopology &topo,
+                    const vector<size_t> &wanted, uint64_t &tick) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    CheckpointHeader h, expected;
+    vector<uint64_t> counts;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1;
+    fillCheckpointHeader(expected, topo, ok ? h.tick : 0);
+    ok = ok && memcmp(&h, &expected, sizeof(h)) == 0 && readArray(f, counts, wanted.size())
+         && equal(counts.begin(), counts.end(), wanted.begin());
+    if (!ok) {
+        cerr << path << " is not a checkpoint of this network and these train counts\n";
+        fclose(f);
+        return false;
+    }
+    ok = engine.readState(f, wanted);
+    // a state that is read in full but does not check out leaves the end of the file unseen
+    bool truncated = feof(f);
+    fclose(f);
+    if (!ok && truncated) {
+        cerr << "Truncated checkpoint " << path << '\n';
+        return false;
+    }
+    if (!ok) {
+        cerr << path << " is not a checkpoint of this network and these train counts\n";
+        return false;
+    }
+    tick = h.tick;
+    return true;
+}
+
+#endif //CS3210_ASSIGNMENT1_CHECKPOINT_H
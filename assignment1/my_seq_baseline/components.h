@@ -0,0 +1,132 @@
+#ifndef CS3210_ASSIGNMENT1_COMPONENTS_H
+#define CS3210_ASSIGNMENT1_COMPONENTS_H
+
+#include "soa_engine.h"
+#include "digest.h"
+#include "thread_pool.h"
+#include <numeric>
+#include <thread>
+
+/* Runs independent parts of the network on separate threads.
+ *
+ * Trains of different lines only interact through the platforms and links they both use, and a
+ * platform shares its id with its link. Lines are grouped into the connected components of the
+ * shared-resource graph; each component gets its own SoAEngine, run on a pool thread with no
+ * synchronization at all, and the printed segments are merged per tick in print order. */
+
+class LineUnionFind {
+public:
+    explicit LineUnionFind(unsigned num_lines) : parent(num_lines) {
+        iota(parent.begin(), parent.end(), 0);
+    }
+
+    unsigned find(unsigned l) {
+        while (parent[l] != l) {
+            parent[l] = parent[parent[l]];
+            l = parent[l];
+        }
+        return l;
+    }
+
+    void unite(unsigned a, unsigned b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) parent[max(a, b)] = min(a, b);
+    }
+
+private:
+    vector<unsigned> parent;
+};
+
+// Groups of lines that share at least one platform or link, directly or through other lines.
+vector<vector<uint32_t>> findLineComponents(const SoATopology &topo) {
+    LineUnionFind uf(topo.numLines());
+    vector<uint32_t> first_user(topo.link_distance.size(), SOA_NONE);      // first line using each link
+    for (uint32_t l = 0; l < topo.numLines(); ++l) {
+        uint32_t end = topo.line_route_base[l] + 2 * topo.line_num_stations[l];
+        for (uint32_t r = topo.line_route_base[l]; r < end; ++r) {
+            uint32_t link = topo.route_link[r];
+            if (link == SOA_NONE) continue;
+            if (first_user[link] == SOA_NONE) {
+                first_user[link] = l;
+            } else {
+                uf.unite(first_user[link], l);
+            }
+        }
+    }
+
+    vector<vector<uint32_t>> components;
+    vector<int> component_of(topo.numLines(), -1);
+    for (uint32_t l = 0; l < topo.numLines(); ++l) {
+        unsigned root = uf.find(l);
+        if (component_of[root] < 0) {
+            component_of[root] = components.size();
+            components.emplace_back();
+        }
+        components[component_of[root]].push_back(l);
+    }
+    return components;
+}
+
+void simulateComponents(const Network &network,
+                        size_t ticks,
+                        const vector<size_t> &wanted,
+                        size_t num_lines,
+                        DigestRecorder *digest) {
+    SoATopology topo(network);
+    const size_t print_from = num_lines <= ticks ? ticks - num_lines : ticks;
+    vector<vector<uint32_t>> components = findLineComponents(topo);
+
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+
+    // each line's part of every printed tick goes to its own in-memory formatter, line_ends[line][i]
+    // is where the part of tick print_from + i ends
+    vector<TraceFormatter *> printed;
+    vector<vector<size_t>> line_ends(topo.numLines());
+    for (uint32_t l = 0; l < topo.numLines(); ++l) printed.push_back(new TraceFormatter(fragments, -1));
+    // canonical digests are sums, so the components' parts of each sampled tick add up to the whole
+    vector<vector<uint64_t>> partial_digests(components.size());
+    WorkStealingPool pool(min<size_t>(max(1u, thread::hardware_concurrency()), components.size()));
+    for (size_t c = 0; c < components.size(); ++c) {
+        pool.submit([&, c]() {
+            const vector<uint32_t> &lines = components[c];
+            SoAEngine engine(topo);
+            engine.setLines(lines);
+            for (size_t tick = 0; tick < ticks; ++tick) {
+                engine.spawnTick(wanted);
+                engine.step();
+                if (tick >= print_from) {
+                    for (uint32_t l: lines) {
+                        engine.writeLine(l, *printed[l]);
+                        line_ends[l].push_back(printed[l]->size());
+                    }
+                }
+                if (digest != nullptr && digest->wants(tick)) partial_digests[c].push_back(engine.canonicalDigest());
+            }
+        });
+    }
+    pool.run();
+
+    if (digest != nullptr) {
+        for (size_t i = 0, tick = 0; tick < ticks; ++i, tick = digest->nextSample(tick)) {
+            uint64_t sum = 0;
+            for (const vector<uint64_t> &part: partial_digests) sum += part[i];
+            if (!digest->record(tick, sum)) break;
+        }
+    }
+
+    TraceFormatter out(fragments, STDOUT_FILENO);
+    for (size_t i = 0; i < ticks - print_from; ++i) {    // print info
+        out.beginTick(print_from + i);
+        for (uint32_t l: topo.print_order) {
+            size_t begin = i == 0 ? 0 : line_ends[l][i - 1];
+            out.appendBytes(printed[l]->bytes() + begin, line_ends[l][i] - begin);
+        }
+        out.endTick();
+    }
+    for (TraceFormatter *f: printed) delete f;
+    flushOrExit(out);
+}
+
+#endif //CS3210_ASSIGNMENT1_COMPONENTS_H
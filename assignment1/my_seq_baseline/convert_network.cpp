@@ -0,0 +1,43 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -fopenmp -o convert_network convert_network.cpp
+ * Run: ./convert_network <input_file> [--format=matrix|sparse|binary] [-o FILE]
+ * Reads a network in any input format of ./main and writes it in the given one (sparse by default),
+ * to stdout unless -o is given. Converting back gives the same simulation output.
+ */
+#include "netwriter.h"
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        cerr << argv[0] << " <input_file> [--format=matrix|sparse|binary] [-o FILE]\n";
+        exit(1);
+    }
+    NETWORK_FORMAT format = NETWORK_FORMAT_SPARSE;
+    const char *out_path = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg.rfind("--format=", 0) != 0 || !parseNetworkFormat(arg.substr(strlen("--format=")), format)) {
+            cerr << "Bad option " << arg << '\n';
+            exit(1);
+        }
+    }
+
+    NetworkSpec spec;
+    if (!loadNetworkSpec(argv[1], spec)) {
+        exit(2);
+    }
+
+    FILE *f = out_path != nullptr ? fopen(out_path, "wb") : stdout;
+    if (f == nullptr) {
+        cerr << "Failed to open " << out_path << '\n';
+        exit(2);
+    }
+    bool ok = writeNetwork(f, spec, format);
+    ok = (f == stdout ? fflush(f) == 0 : fclose(f) == 0) && ok;
+    if (!ok) {
+        cerr << "Failed to write the network\n";
+        exit(2);
+    }
+    return 0;
+}
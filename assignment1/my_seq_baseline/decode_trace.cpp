@@ -0,0 +1,86 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -fopenmp -pthread -o decode_trace decode_trace.cpp
+ * Run: ./decode_trace <trace_file> [--from=T] [--to=T] [--info]
+ * Prints the ticks [T_from, T_to) of a ./main --delta-trace=FILE run as ./main prints them, all the
+ * recorded ticks by default. --info prints the tick range and the number of changes instead.
+ */
+#include "delta_trace.h"
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        cerr << argv[0] << " <trace_file> [--from=T] [--to=T] [--info]\n";
+        exit(1);
+    }
+    uint64_t from = 0, to = UINT64_MAX;
+    bool info = false;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--from=", 0) == 0) {
+            from = strtoull(arg.c_str() + strlen("--from="), nullptr, 10);
+        } else if (arg.rfind("--to=", 0) == 0) {
+            to = strtoull(arg.c_str() + strlen("--to="), nullptr, 10);
+        } else if (arg == "--info") {
+            info = true;
+        } else {
+            cerr << "Bad option " << arg << '\n';
+            exit(1);
+        }
+    }
+
+    DeltaTraceReader trace;
+    if (!trace.open(argv[1])) {
+        exit(2);
+    }
+    const DeltaTraceHeader &h = trace.header;
+    if (info) {
+        printf("ticks %llu to %llu, %llu trains, %llu changes\n", (unsigned long long)h.first_tick,
+               (unsigned long long)h.end_tick, (unsigned long long)h.num_trains, (unsigned long long)h.num_changes);
+        return 0;
+    }
+    from = max(from, h.first_tick);
+    to = min(to, h.end_tick);
+
+    // trains seen so far, by line rank and then in id order, and where each one is
+    uint32_t num_ranks = 0;
+    for (uint32_t r: trace.train_rank) num_ranks = max(num_ranks, r + 1);
+    vector<vector<uint32_t>> shown(num_ranks);
+    vector<uint32_t> location(h.num_trains, DELTA_NOWHERE);
+
+    TraceFormatter out(trace.fragments, STDOUT_FILENO);
+    vector<uint32_t> changes;
+    uint64_t record_tick = 0;
+    bool pending = trace.next(record_tick, changes);
+    for (uint64_t tick = h.first_tick; tick < to; ++tick) {
+        if (pending && record_tick == tick) {
+            for (size_t i = 0; i < changes.size(); i += 2) {
+                uint32_t id = changes[i];
+                if (location[id] == DELTA_NOWHERE) shown[trace.train_rank[id]].push_back(id);
+                location[id] = changes[i + 1];
+            }
+            pending = trace.next(record_tick, changes);
+        } else if (tick < from) {
+            // nothing to print or change before the next record
+            tick = (pending ? min(record_tick, from) : from) - 1;
+            continue;
+        }
+        if (tick < from) continue;
+
+        out.beginTick(tick);
+        for (const vector<uint32_t> &ids: shown) {
+            for (uint32_t id: ids) {
+                if (location[id] & 1) {
+                    out.trainOnLink(id, location[id] / 2);
+                } else {
+                    out.trainAtStation(id, location[id] / 2);
+                }
+            }
+        }
+        out.endTick();
+    }
+    flushOrExit(out);
+    if (!pending && !trace.atEnd()) {
+        cerr << argv[1] << " has a damaged record\n";
+        exit(2);
+    }
+    return 0;
+}
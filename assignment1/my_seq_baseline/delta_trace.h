@@ -0,0 +1,257 @@
+#ifndef CS3210_ASSIGNMENT1_DELTA_TRACE_H
+#define CS3210_ASSIGNMENT1_DELTA_TRACE_H
+
+#include "loader.h"
+#include "trace_formatter.h"
+
+/* Transition trace: the printed ticks stored as the changes between them instead of as text.
+ *
+ * A train keeps its position for many ticks while it loads, queues or crosses a link, yet the text
+ * output repeats it on every line. This format records a train only on the ticks where what would
+ * be printed for it changes, including the tick it first appears. ./decode_trace (decode_trace.cpp)
+ * replays the changes and prints the usual lines for any tick range.
+ *
+ * Layout, little-endian:
+ *   DeltaTraceHeader
+ *   train_end[num_trains] (u64)   ends of the "g12-" pieces in the pool that follows
+ *   train pool
+ *   train_rank[num_trains] (u32)  position of the train's line in the print order
+ *   station_end[num_stations] (u64), station pool
+ *   link_end[num_links] (u64), link pool
+ *   records up to the end of the file, one per tick with changes, as varints:
+ *     tick - previous record's tick (first_tick for the first one), count,
+ *     then count pairs of train id and location, 2 * station or 2 * link + 1
+ *
+ * Within a line trains are printed in id order, so the rank and the id place every train in the line.
+ * The header is rewritten when the run ends, since only then first_tick and end_tick are known. */
+
+#define DELTA_MAGIC "MRTDELT"
+#define DELTA_VERSION 1
+#define DELTA_NOWHERE UINT32_MAX
+
+struct DeltaTraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_trains;                // train ids with a name, not all of them need to appear
+    uint64_t num_stations;
+    uint64_t num_links;
+    uint64_t train_bytes;
+    uint64_t station_bytes;
+    uint64_t link_bytes;
+    uint64_t first_tick;                // first printed tick
+    uint64_t end_tick;                  // one past the last printed tick
+    uint64_t num_changes;
+};
+
+inline uint32_t stationLocation(uint32_t station) {
+    return 2 * station;
+}
+
+inline uint32_t linkLocation(uint32_t link) {
+    return 2 * link + 1;
+}
+
+inline void appendVarint(vector<char> &buf, uint64_t v) {
+    while (v >= 0x80) {
+        buf.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((char)v);
+}
+
+inline bool readVarint(const char *&p, const char *end, uint64_t &v) {
+    v = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+class DeltaTraceWriter {
+public:
+    // fd must be a regular file, the header is rewritten in place by finish()
+    DeltaTraceWriter(const TraceFragments &fragments, const vector<uint32_t> &train_rank, int fd)
+            : out(fragments, fd) {
+        this->fd = fd;
+        this->last.assign(train_rank.size(), DELTA_NOWHERE);
+        memset(&this->header, 0, sizeof(this->header));
+        memcpy(this->header.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC));
+        this->header.version = DELTA_VERSION;
+        this->header.num_trains = fragments.trains.size();
+        this->header.num_stations = fragments.stations.size();
+        this->header.num_links = fragments.links.size();
+        this->header.first_tick = this->header.end_tick = this->previous = UINT64_MAX;
+        this->out.appendBytes((const char *)&this->header, sizeof(this->header));
+        this->header.train_bytes = appendTable(fragments.trains);
+        this->out.appendBytes((const char *)train_rank.data(), train_rank.size() * sizeof(uint32_t));
+        this->header.station_bytes = appendTable(fragments.stations);
+        this->header.link_bytes = appendTable(fragments.links);
+    }
+
+    void beginTick(uint64_t tick) {
+        if (this->header.first_tick == UINT64_MAX) this->header.first_tick = this->previous = tick;
+        this->tick = tick;
+        this->changes.clear();
+    }
+
+    // called for every train of the tick, in id order
+    void train(uint32_t id, uint32_t location) {
+        if (this->last[id] == location) return;
+        this->last[id] = location;
+        this->changes.push_back(id);
+        this->changes.push_back(location);
+    }
+
+    void endTick() {
+        this->header.end_tick = this->tick + 1;
+        if (this->changes.empty()) return;
+        this->record.clear();
+        appendVarint(this->record, this->tick - this->previous);
+        appendVarint(this->record, this->changes.size() / 2);
+        for (uint32_t v: this->changes) appendVarint(this->record, v);
+        this->out.appendBytes(this->record.data(), this->record.size());
+        this->out.spill();
+        this->previous = this->tick;
+        this->header.num_changes += this->changes.size() / 2;
+    }
+
+    // Writes what is left and the final header; false if the file could not be completed.
+    bool finish(uint64_t no_ticks_at) {
+        this->out.flush();
+        if (this->header.first_tick == UINT64_MAX) this->header.first_tick = this->header.end_tick = no_ticks_at;
+        return this->out.writeError() == 0
+               && pwrite(this->fd, &this->header, sizeof(this->header), 0) == (ssize_t)sizeof(this->header)
+               && this->out.position() == (uint64_t)lseek(this->fd, 0, SEEK_END);
+    }
+
+    uint64_t flushNanos() const {
+        return this->out.flushNanos();
+    }
+
+private:
+    TraceFormatter out;                 // only used as a byte sink with its writer thread
+    int fd;
+    DeltaTraceHeader header;
+    vector<uint32_t> last;              // location last recorded per train id
+    vector<uint32_t> changes;           // id, location pairs of the current tick
+    vector<char> record;
+    uint64_t tick;
+    uint64_t previous;                  // tick of the last record
+
+    uint64_t appendTable(const FragmentTable &table) {
+        vector<uint64_t> ends;
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < table.size(); ++i) {
+            bytes += table.length(i);
+            ends.push_back(bytes);
+        }
+        this->out.appendBytes((const char *)ends.data(), ends.size() * sizeof(uint64_t));
+        for (uint32_t i = 0; i < table.size(); ++i) this->out.appendBytes(table.data(i), table.length(i));
+        return bytes;
+    }
+};
+
+class DeltaTraceReader {
+public:
+    DeltaTraceHeader header;
+    TraceFragments fragments;
+    vector<uint32_t> train_rank;
+
+    // Reads everything up to the records; false and a message when path is not a complete trace.
+    bool open(const char *path) {
+        if (!this->file.open(path)) {
+            cerr << "Failed to open " << path << '\n';
+            return false;
+        }
+        if (this->file.length() < sizeof(this->header)) return bad(path);
+        memcpy(&this->header, this->file.begin(), sizeof(this->header));
+        if (memcmp(this->header.magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0) return bad(path);
+        if (this->header.version != DELTA_VERSION) {
+            cerr << path << " has trace version " << this->header.version << ", expected " << DELTA_VERSION << '\n';
+            return false;
+        }
+        if (this->header.first_tick == UINT64_MAX) {
+            cerr << path << " was not finished by its run\n";
+            return false;
+        }
+        this->p = this->file.begin() + sizeof(this->header);
+        if (!takeTable(this->fragments.trains, this->header.num_trains, this->header.train_bytes)
+            || !take(this->train_rank, this->header.num_trains)
+            || !takeTable(this->fragments.stations, this->header.num_stations, this->header.station_bytes)
+            || !takeTable(this->fragments.links, this->header.num_links, this->header.link_bytes)) {
+            return bad(path);
+        }
+        this->records = this->p;
+        rewind();
+        return true;
+    }
+
+    // back to before the first record
+    void rewind() {
+        this->p = this->records;
+        this->tick = this->header.first_tick;
+    }
+
+    bool atEnd() const {
+        return this->p == this->file.end();
+    }
+
+    // Reads the next record into id, location pairs; false at the end or on a damaged record.
+    bool next(uint64_t &tick, vector<uint32_t> &changes) {
+        uint64_t gap, count, v;
+        if (!readVarint(this->p, this->file.end(), gap) || !readVarint(this->p, this->file.end(), count)) return false;
+        this->tick += gap;
+        tick = this->tick;
+        changes.clear();
+        for (uint64_t i = 0; i < 2 * count; ++i) {
+            if (!readVarint(this->p, this->file.end(), v)) return false;
+            changes.push_back(v);
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            uint32_t id = changes[2 * i], location = changes[2 * i + 1];
+            if (id >= this->header.num_trains
+                || (location & 1 ? location / 2 >= this->header.num_links : location / 2 >= this->header.num_stations)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    MappedFile file;
+    const char *p;
+    const char *records;
+    uint64_t tick;
+
+    bool bad(const char *path) {
+        cerr << path << " is not a transition trace\n";
+        return false;
+    }
+
+    template<typename T>
+    bool take(vector<T> &a, uint64_t n) {
+        if (n > (uint64_t)(this->file.end() - this->p) / sizeof(T)) return false;
+        a.resize(n);
+        memcpy(a.data(), this->p, n * sizeof(T));
+        this->p += n * sizeof(T);
+        return true;
+    }
+
+    bool takeTable(FragmentTable &table, uint64_t n, uint64_t bytes) {
+        vector<uint64_t> ends;
+        if (!take(ends, n) || bytes > (uint64_t)(this->file.end() - this->p)) return false;
+        uint64_t begin = 0;
+        for (uint64_t e: ends) {
+            if (e < begin || e > bytes) return false;
+            table.add(string(this->p + begin, e - begin));
+            begin = e;
+        }
+        this->p += bytes;
+        return true;
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_DELTA_TRACE_H
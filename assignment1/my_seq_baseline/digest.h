@@ -0,0 +1,100 @@
+#ifndef CS3210_ASSIGNMENT1_DIGEST_H
+#define CS3210_ASSIGNMENT1_DIGEST_H
+
+#include "soa_engine.h"
+#include <cinttypes>
+#include <cstdio>
+
+/* Rolling digest of the canonical state, for checking engines against each other without printing.
+ *
+ * Every `every`-th tick (ticks divisible by it) the engine hands over the canonical state digest
+ * (see trainStateDigest), which is folded into a running digest. The samples can be written as a
+ * stream of "tick state rolling" lines in hex, and a stream written by another run can be compared
+ * against while running: the first sampled tick whose state differs is reported and the run stops. */
+
+struct DigestOptions {
+    uint64_t every = 1;
+    string out_path;                    // write the digest stream here
+    string compare_path;                // compare against a stream written with out_path
+};
+
+class DigestRecorder {
+public:
+    explicit DigestRecorder(const DigestOptions &opts) {
+        this->every = max<uint64_t>(opts.every, 1);
+        this->rolling = 0;
+        this->samples = 0;
+        this->diverged_at = UINT64_MAX;
+        this->out = nullptr;
+        this->reference = nullptr;
+        this->failed = false;
+        if (!opts.out_path.empty() && (this->out = fopen(opts.out_path.c_str(), "w")) == nullptr) {
+            cerr << "Failed to open " << opts.out_path << '\n';
+            this->failed = true;
+        }
+        if (!opts.compare_path.empty() && (this->reference = fopen(opts.compare_path.c_str(), "r")) == nullptr) {
+            cerr << "Failed to open " << opts.compare_path << '\n';
+            this->failed = true;
+        }
+    }
+
+    ~DigestRecorder() {
+        if (this->out != nullptr) fclose(this->out);
+        if (this->reference != nullptr) fclose(this->reference);
+    }
+
+    bool ok() const {
+        return !this->failed;
+    }
+
+    bool wants(uint64_t tick) const {
+        return tick % this->every == 0;
+    }
+
+    // first sampled tick after tick
+    uint64_t nextSample(uint64_t tick) const {
+        return (tick / this->every + 1) * this->every;
+    }
+
+    bool diverged() const {
+        return this->diverged_at != UINT64_MAX;
+    }
+
+    // Returns false once the run no longer matches the reference stream.
+    bool record(uint64_t tick, uint64_t state) {
+        if (diverged()) return false;
+        this->rolling = mixHash(mixHash(this->rolling, tick), state);
+        this->samples++;
+        if (this->out != nullptr) {
+            fprintf(this->out, "%" PRIu64 " %016" PRIx64 " %016" PRIx64 "\n", tick, state, this->rolling);
+        }
+        if (this->reference != nullptr) {
+            uint64_t ref_tick, ref_state, ref_rolling;
+            if (fscanf(this->reference, "%" SCNu64 " %" SCNx64 " %" SCNx64, &ref_tick, &ref_state, &ref_rolling) != 3
+                || ref_tick != tick || ref_state != state) {
+                this->diverged_at = tick;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report() const {
+        if (diverged()) {
+            fprintf(stderr, "first divergent tick %" PRIu64 "\n", this->diverged_at);
+        } else {
+            fprintf(stderr, "digest %016" PRIx64 " over %" PRIu64 " samples\n", this->rolling, this->samples);
+        }
+    }
+
+private:
+    uint64_t every;
+    uint64_t rolling;
+    uint64_t samples;
+    uint64_t diverged_at;
+    FILE *out;
+    FILE *reference;
+    bool failed;
+};
+
+#endif //CS3210_ASSIGNMENT1_DIGEST_H
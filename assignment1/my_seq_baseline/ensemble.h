@@ -0,0 +1,400 @@
+#ifndef CS3210_ASSIGNMENT1_ENSEMBLE_H
+#define CS3210_ASSIGNMENT1_ENSEMBLE_H
+
+#include "batch.h"
+
+/* Many scenarios over one network stepped together, one SIMD lane each.
+ *
+ * Every per-train array holds K lanes side by side: element t * K + k is the t-th spawned train of
+ * scenario k (which is also its train id there), so a train row is one contiguous vector across
+ * scenarios. Platforms, links, popularities and distances are laid out the same way, so scenarios may
+ * also differ in popularity and distance.
+ *
+ * The countdown kernel runs over all rows at once. Besides the counters it applies the two
+ * transitions that only touch the train itself (opening the door, starting to load) as masked blends,
+ * which leaves every lane with one of the same few states no matter where the scenarios have drifted
+ * apart. Whatever needs the shared platform and link state (leaving a platform, taking a link,
+ * arriving) is flagged and done by the scalar pass, row by row so every lane still sees its trains
+ * in id order. Trains only reach a platform through the scalar pass or through spawning, so the blends
+ * never act on a state a lower id could still change within the tick. Queued trains are not flagged
+ * at all: the train freeing their platform moves them on, see leavePlatform. */
+
+struct EnsembleJob : BatchJob {
+    vector<pair<uint32_t, uint32_t>> popularity;        // station, popularity
+    vector<pair<uint32_t, uint32_t>> distance;          // link, distance
+    uint64_t digest;                    // canonical digest after the last tick, filled in by runEnsemble
+};
+
+/* Same lines as a batch jobs file, optionally followed by "station=popularity" and "src->dst=distance"
+ * fields changing the network for that job only:
+ *   2000 10 10 10 5 changi=3 changi->tampines=12 */
+bool loadEnsembleJobs(const string &path, const Network &network, vector<EnsembleJob> &jobs) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    const unsigned network_lines = network.numLines();
+    string text;
+    for (unsigned line_no = 1; getline(in, text); ++line_no) {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string::npos || text[first] == '#') continue;
+        istringstream fields(text);
+        EnsembleJob job = {};
+        vector<size_t> values;
+        string field;
+        while (fields >> field) {
+            size_t eq = field.find('=');
+            if (eq == string::npos) {
+                char *end;
+                values.push_back(strtoull(field.c_str(), &end, 10));
+                if (*end == '\0' && job.popularity.empty() && job.distance.empty()) continue;
+                cerr << path << ':' << line_no << ": bad field " << field << '\n';
+                return false;
+            }
+            string name = field.substr(0, eq);
+            uint32_t value = strtoul(field.c_str() + eq + 1, nullptr, 10);
+            size_t arrow = name.find("->");
+            auto src = network.stations_by_name.find(arrow == string::npos ? name : name.substr(0, arrow));
+            auto dst = arrow == string::npos ? src : network.stations_by_name.find(name.substr(arrow + 2));
+            Link *link = nullptr;
+            if (src != network.stations_by_name.end() && dst != network.stations_by_name.end() && arrow != string::npos) {
+                link = src->second->getTargetLink(dst->second);
+            }
+            if (src == network.stations_by_name.end() || dst == network.stations_by_name.end()
+                || (arrow != string::npos && link == nullptr) || value == 0) {
+                cerr << path << ':' << line_no << ": no station or link " << name << " to set to " << value << '\n';
+                return false;
+            }
+            if (link != nullptr) {
+                job.distance.push_back({link->getId(), value});
+            } else {
+                job.popularity.push_back({src->second->getId(), value});
+            }
+        }
+        if (values.size() != network_lines + 2) {
+            cerr << path << ':' << line_no << ": expected N, " << network_lines << " train counts and num_lines\n";
+            return false;
+        }
+        job.ticks = values.front();
+        job.num_trains.assign(values.begin() + 1, values.end() - 1);
+        job.num_lines = values.back();
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+class EnsembleEngine {
+public:
+    EnsembleEngine(const SoATopology &topo, const vector<EnsembleJob *> &jobs) : topo(topo) {
+        K = jobs.size();
+        const size_t S = topo.station_popularity.size(), P = topo.link_distance.size(), L = topo.numLines();
+        size_t rows = 0;
+        for (uint32_t k = 0; k < K; ++k) {
+            wanted.push_back(jobs[k]->num_trains);
+            size_t total = 0;
+            for (size_t n: jobs[k]->num_trains) total += n;
+            rows = max(rows, total);
+        }
+        popularity.resize(S * K);
+        distance.resize(P * K);
+        for (size_t s = 0; s < S; ++s) fill_n(popularity.begin() + s * K, K, topo.station_popularity[s]);
+        for (size_t p = 0; p < P; ++p) fill_n(distance.begin() + p * K, K, topo.link_distance[p]);
+        for (uint32_t k = 0; k < K; ++k) {
+            for (auto &change: jobs[k]->popularity) popularity[change.first * K + k] = change.second;
+            for (auto &change: jobs[k]->distance) distance[change.first * K + k] = change.second;
+        }
+
+        status.assign(rows * K, TRAIN_STATUS_INITIAL);
+        route.assign(rows * K, 0);
+        station_at.assign(rows * K, 0);
+        load_count.assign(rows * K, 0);
+        travel_count.assign(rows * K, 0);
+        queue_next.assign(rows * K, SOA_NONE);
+        ready.assign(rows * K + 8, 0);            // padded for the word reads in step()
+        line.assign(rows * K, 0);
+        platform_occupied.assign(P * K, 0);
+        link_occupied.assign(P * K, 0);
+        queue_head.assign(P * K, SOA_NONE);
+        queue_tail.assign(P * K, SOA_NONE);
+        lane_trains.assign(K, 0);
+        spawned.assign(K * L, 0);
+        line_trains.assign(K * L, vector<uint32_t>());
+        rows_used = 0;
+    }
+
+    // same spawning rule as SoAEngine, for every lane with its own train counts
+    void spawnTick() {
+        for (uint32_t k = 0; k < K; ++k) {
+            for (uint32_t l = 0; l < topo.numLines(); ++l) {
+                size_t cur = spawned[k * topo.numLines() + l];
+                unsigned num = cur + 2 <= wanted[k][l] ? 2 : (cur + 1 <= wanted[k][l] ? 1 : 0);
+                spawned[k * topo.numLines() + l] += num;
+                if (num >= 1) spawnTrain(k, l, false);
+                if (num == 2) spawnTrain(k, l, true);
+            }
+            rows_used = max(rows_used, lane_trains[k]);
+        }
+    }
+
+    // Few trains need the scalar pass in any tick, so the flags are skipped eight at a time.
+    void step() {
+        countdownKernel();
+        for (uint32_t t = 0; t < rows_used; ++t) {
+            const uint8_t *rd = ready.data() + (size_t)t * K;
+            for (uint32_t k = 0; k < K; k += 8) {
+                uint64_t word;
+                memcpy(&word, rd + k, sizeof(word));
+                if (word == 0) continue;
+                for (uint32_t e = k; e < min(k + 8, K); ++e) {
+                    if (rd[e]) transitionTrain(t, e);
+                }
+            }
+        }
+    }
+
+    void writeTick(uint32_t k, size_t tick, TraceFormatter &out) const {
+        out.beginTick(tick);
+        for (uint32_t l: topo.print_order) {
+            for (uint32_t t: line_trains[k * topo.numLines() + l]) {
+                size_t i = (size_t)t * K + k;
+                if (status[i] == TRAIN_STATUS_TRANSITIONING) {
+                    out.trainOnLink(t, topo.route_link[route[i]]);
+                } else {
+                    out.trainAtStation(t, station_at[i]);
+                }
+            }
+        }
+        out.endTick();
+    }
+
+    // SoAEngine::canonicalDigest of one lane
+    uint64_t canonicalDigest(uint32_t k) const {
+        uint64_t sum = 0;
+        for (uint32_t t = 0; t < lane_trains[k]; ++t) {
+            size_t i = (size_t)t * K + k;
+            sum += trainStateDigest(t, status[i], line[i], route[i] - topo.line_route_base[line[i]], station_at[i],
+                                    load_count[i], travel_count[i]);
+        }
+        for (uint32_t p = 0; p < topo.link_distance.size(); ++p) {
+            size_t j = (size_t)p * K + k;
+            if (!platform_occupied[j] && !link_occupied[j] && queue_head[j] == SOA_NONE) continue;
+            uint64_t h = platformStateSeed(p, platform_occupied[j], link_occupied[j]);
+            for (uint32_t q = queue_head[j]; q != SOA_NONE; q = queue_next[(size_t)q * K + k]) h = mixHash(h, q);
+            sum += h;
+        }
+        return sum;
+    }
+
+private:
+    const SoATopology &topo;
+    uint32_t K;                         // lanes
+    vector<vector<size_t>> wanted;      // per lane
+
+    /* per station / link and lane begin */
+    vector<uint32_t> popularity;
+    vector<uint32_t> distance;
+    /* per station / link and lane end */
+
+    /* per train and lane begin */
+    vector<uint8_t> status;
+    vector<uint32_t> route;
+    vector<uint32_t> station_at;
+    vector<uint32_t> load_count;
+    vector<uint32_t> travel_count;
+    vector<uint32_t> queue_next;        // train row of the next train in the same holding area
+    vector<uint8_t> ready;
+    vector<uint32_t> line;
+    /* per train and lane end */
+
+    /* per platform / link and lane begin */
+    vector<uint8_t> platform_occupied;
+    vector<uint8_t> link_occupied;
+    vector<uint32_t> queue_head;
+    vector<uint32_t> queue_tail;
+    /* per platform / link and lane end */
+
+    vector<uint32_t> lane_trains;       // trains spawned per lane
+    vector<size_t> spawned;             // per lane and line
+    vector<vector<uint32_t>> line_trains;       // per lane and line
+    uint32_t rows_used;                 // rows spawned in any lane
+
+    void spawnTrain(uint32_t k, uint32_t l, bool at_terminal) {
+        uint32_t t = lane_trains[k]++;
+        size_t i = (size_t)t * K + k;
+        uint32_t r = topo.spawnRoute(l, at_terminal);
+        route[i] = r;
+        station_at[i] = topo.route_station[r];
+        line[i] = l;
+        line_trains[k * topo.numLines() + l].push_back(t);
+
+        uint32_t plt = topo.route_link[r];
+        platform_occupied[(size_t)plt * K + k] ? enterPlatformQueue(t, k, plt) : enterPlatform(t, k, plt);
+    }
+
+    void countdownKernel() {
+        uint8_t *st = status.data();
+        uint32_t *lc = load_count.data();
+        uint32_t *tc = travel_count.data();
+        uint8_t *rd = ready.data();
+        const size_t n = (size_t)rows_used * K;
+#pragma omp simd
+        for (size_t i = 0; i < n; ++i) {
+            uint8_t s = st[i];
+            uint32_t l = lc[i], c = tc[i];
+            uint32_t opening = s == TRAIN_STATUS_IN_PLATFORM;
+            uint32_t boarding = s == TRAIN_STATUS_OPENING_DOOR;
+            uint32_t load_dec = ((s == TRAIN_STATUS_LOADING_PASSENGERS) & (l != 0)) | boarding;
+            uint32_t travel_dec = (s == TRAIN_STATUS_TRANSITIONING) & (c != 0);
+            lc[i] = l - load_dec;
+            tc[i] = c - travel_dec;
+            st[i] = opening ? (uint8_t)TRAIN_STATUS_OPENING_DOOR : (boarding ? (uint8_t)TRAIN_STATUS_LOADING_PASSENGERS : s);
+            rd[i] = !(opening | load_dec | travel_dec) & (s != TRAIN_STATUS_INITIAL)
+                    & (s != TRAIN_STATUS_QUEUEING_FOR_PLATFORM);
+        }
+    }
+
+    /* transitions begin, mirror SoAEngine */
+    void enterPlatform(uint32_t t, uint32_t k, uint32_t plt) {
+        size_t i = (size_t)t * K + k;
+        status[i] = TRAIN_STATUS_IN_PLATFORM;
+        station_at[i] = topo.route_station[route[i]];
+        load_count[i] = popularity[(size_t)station_at[i] * K + k];
+        platform_occupied[(size_t)plt * K + k] = 1;
+    }
+
+    void enterPlatformQueue(uint32_t t, uint32_t k, uint32_t plt) {
+        size_t i = (size_t)t * K + k, j = (size_t)plt * K + k;
+        status[i] = TRAIN_STATUS_QUEUEING_FOR_PLATFORM;
+        queue_next[i] = SOA_NONE;
+        if (queue_tail[j] == SOA_NONE) {
+            queue_head[j] = t;
+        } else {
+            queue_next[(size_t)queue_tail[j] * K + k] = t;
+        }
+        queue_tail[j] = t;
+    }
+
+    // Called by row t. SoAEngine would still reach a queued train with a higher id in this tick and
+    // open its door; the kernel did not flag queued trains, so that happens right here instead.
+    void leavePlatform(uint32_t t, uint32_t k, uint32_t plt) {
+        size_t j = (size_t)plt * K + k;
+        platform_occupied[j] = 0;
+        uint32_t first = queue_head[j];
+        if (first != SOA_NONE) {
+            size_t f = (size_t)first * K + k;
+            enterPlatform(first, k, plt);
+            if (first > t) status[f] = TRAIN_STATUS_OPENING_DOOR;
+            queue_head[j] = queue_next[f];
+            queue_next[f] = SOA_NONE;
+            if (queue_head[j] == SOA_NONE) queue_tail[j] = SOA_NONE;
+        }
+    }
+
+    // only the states the kernel leaves to the scalar pass
+    void transitionTrain(uint32_t t, uint32_t k) {
+        size_t i = (size_t)t * K + k;
+        switch (status[i]) {
+            case TRAIN_STATUS_LOADING_PASSENGERS:       // only reached once the counter finished
+            case TRAIN_STATUS_WAITING_FOR_LINK: {
+                uint32_t link = topo.route_link[route[i]];
+                size_t j = (size_t)link * K + k;
+                if (!link_occupied[j]) {
+                    status[i] = TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK;
+                    travel_count[i] = distance[j];
+                    link_occupied[j] = 1;
+                } else {
+                    status[i] = TRAIN_STATUS_WAITING_FOR_LINK;
+                }
+                break;
+            }
+            case TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK: {
+                uint32_t link = topo.route_link[route[i]];
+                leavePlatform(t, k, link);
+                status[i] = TRAIN_STATUS_TRANSITIONING;
+                link_occupied[(size_t)link * K + k] = 1;
+                travel_count[i]--;
+                break;
+            }
+            case TRAIN_STATUS_TRANSITIONING: {          // only reached once the counter finished
+                link_occupied[(size_t)topo.route_link[route[i]] * K + k] = 0;
+                route[i] = topo.route_arrival[route[i]];
+                uint32_t plt = topo.route_link[route[i]];
+                if (platform_occupied[(size_t)plt * K + k]) {
+                    enterPlatformQueue(t, k, plt);
+                } else {
+                    enterPlatform(t, k, plt);
+                    status[i] = TRAIN_STATUS_OPENING_DOOR;
+                }
+                break;
+            }
+            default: cout<<"Unexpected status of train id "<<t<<endl; break;
+        }
+    }
+    /* transitions end */
+};
+
+/* Jobs are sorted by N and cut into groups of `lanes`, so the lanes of a group finish close together;
+ * a lane past its own N keeps running unprinted until the group ends. Groups are spread over the
+ * work-stealing pool like batch jobs, and every job writes <out_dir>/job<i>.out. */
+void runEnsemble(const Network &network, vector<EnsembleJob> &jobs, const string &out_dir, unsigned lanes,
+                 unsigned num_threads) {
+    const SoATopology topo(network);
+    vector<size_t> order(jobs.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return jobs[a].ticks < jobs[b].ticks; });
+    size_t groups = (jobs.size() + lanes - 1) / lanes;
+    WorkStealingPool pool(min<size_t>(num_threads, groups));
+
+    for (size_t g = 0; g < groups; ++g) {
+        pool.submit([&, g] {
+            vector<size_t> members(order.begin() + g * lanes, order.begin() + min(jobs.size(), (g + 1) * lanes));
+            vector<EnsembleJob *> group;
+            vector<TraceFragments> fragments(members.size());
+            vector<TraceFormatter *> outs;
+            vector<int> fds;
+            size_t ticks = 0;
+            for (size_t k = 0; k < members.size(); ++k) {
+                EnsembleJob &job = jobs[members[k]];
+                group.push_back(&job);
+                ticks = max(ticks, job.ticks);
+                string path = out_dir + "/job" + to_string(members[k]) + ".out";
+                int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                job.ok = fd >= 0;
+                fds.push_back(fd);
+                makeTraceFragments(network, job.num_trains, fragments[k]);
+                outs.push_back(new TraceFormatter(fragments[k], fd));
+            }
+
+            auto before = chrono::steady_clock::now();
+            EnsembleEngine engine(topo, group);
+            for (uint32_t k = 0; k < group.size(); ++k) group[k]->digest = engine.canonicalDigest(k);
+            for (size_t tick = 0; tick < ticks; ++tick) {
+                engine.spawnTick();
+                engine.step();
+                for (uint32_t k = 0; k < group.size(); ++k) {
+                    const EnsembleJob &job = *group[k];
+                    if (tick >= job.ticks) continue;
+                    size_t print_from = job.num_lines <= job.ticks ? job.ticks - job.num_lines : job.ticks;
+                    if (tick >= print_from && job.ok) engine.writeTick(k, tick, *outs[k]);
+                    if (tick + 1 == job.ticks) group[k]->digest = engine.canonicalDigest(k);
+                }
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - before).count();
+
+            for (size_t k = 0; k < members.size(); ++k) {
+                group[k]->seconds = seconds;
+                outs[k]->flush();
+                if (group[k]->ok && outs[k]->writeError() != 0) {
+                    group[k]->ok = false;
+                    group[k]->write_error = outs[k]->writeError();
+                }
+                delete outs[k];
+                if (fds[k] >= 0) close(fds[k]);
+            }
+        });
+    }
+    pool.run();
+}
+
+#endif //CS3210_ASSIGNMENT1_ENSEMBLE_H
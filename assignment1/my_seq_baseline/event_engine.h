@@ -0,0 +1,183 @@
+#ifndef CS3210_ASSIGNMENT1_EVENT_ENGINE_H
+#define CS3210_ASSIGNMENT1_EVENT_ENGINE_H
+
+#include "soa_engine.h"
+#include "digest.h"
+#include "timing_wheel.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+/* Discrete-event version of simulate().
+ *
+ * A train that is loading passengers or transitioning does nothing but count down, so instead of
+ * visiting it every tick its next state change is put on a timing wheel at the tick the counter would
+ * finish (station popularity / link distance ticks ahead). Trains blocked on a platform or a link are
+ * woken by the train that frees it. Within a tick, due trains still run in spawn order: a train woken
+ * by a lower id runs in the same tick, by a higher id in the next one, exactly like the tick loop.
+ * Ticks without events are skipped, except while spawning and in the printed window. */
+class EventEngine : public SoAEngine {
+public:
+    explicit EventEngine(const SoATopology &topo) : SoAEngine(topo) {
+        link_waiter.assign(topo.link_distance.size(), SOA_NONE);
+    }
+
+    // Spawns this tick's trains and runs every due train of the wheel's current tick.
+    void runTick(const vector<size_t> &wanted) {
+        uint64_t tick = wheel.currentTick();
+        size_t first_new = numTrains();
+        spawnTick(wanted);
+        last_run.resize(numTrains(), 0);
+        finish_at.resize(numTrains(), 0);
+        for (uint32_t t = first_new; t < numTrains(); ++t) {
+            if (status[t] == TRAIN_STATUS_IN_PLATFORM) agenda.push(t);
+        }
+
+        due.clear();
+        wheel.popDue(due);
+        for (uint32_t t: due) agenda.push(t);
+
+        while (!agenda.empty()) {
+            uint32_t t = agenda.top();
+            agenda.pop();
+            if (last_run[t] == tick + 1) continue;     // woken twice
+            last_run[t] = tick + 1;
+            runTrain(t, tick);
+        }
+    }
+
+    uint64_t nextEventTick() const {
+        return wheel.nextTick();
+    }
+
+    void advanceTo(uint64_t tick) {
+        wheel.advanceTo(tick);
+    }
+
+    // countdowns are only kept as the tick they finish at
+    uint64_t canonicalDigest(uint64_t tick) const {
+        return SoAEngine::canonicalDigest(finish_at.data(), tick);
+    }
+
+private:
+    TimingWheel wheel;
+    priority_queue<uint32_t, vector<uint32_t>, greater<uint32_t>> agenda;     // due this tick, by id
+    vector<uint32_t> due;
+    vector<uint32_t> link_waiter;       // train waiting for each link
+    vector<uint64_t> last_run;          // 1 + last tick the train ran, 0 if never
+    vector<uint64_t> finish_at;         // tick the current countdown finishes at
+
+    void wake(uint32_t t, uint32_t by, uint64_t tick) {
+        // the tick loop reaches higher ids later in the same tick
+        if (t > by) {
+            agenda.push(t);
+        } else {
+            wheel.schedule(tick + 1, t);
+        }
+    }
+
+    void tryLink(uint32_t t, uint64_t tick) {
+        uint32_t link = topo.route_link[route[t]];
+        if (!link_occupied[link]) {
+            waitForAnotherTickToLink(t, link);
+            wheel.schedule(tick + 1, t);
+        } else {
+            status[t] = TRAIN_STATUS_WAITING_FOR_LINK;
+            link_waiter[link] = t;
+        }
+    }
+
+    void runTrain(uint32_t t, uint64_t tick) {
+        switch (status[t]) {
+            case TRAIN_STATUS_IN_PLATFORM: {
+                status[t] = TRAIN_STATUS_OPENING_DOOR;
+                wheel.schedule(tick + 1, t);
+                break;
+            }
+            case TRAIN_STATUS_OPENING_DOOR: {
+                status[t] = TRAIN_STATUS_LOADING_PASSENGERS;
+                load_count[t]--;
+                finish_at[t] = tick + (uint64_t)load_count[t] + 1;
+                wheel.schedule(finish_at[t], t);
+                load_count[t] = 0;      // what the tick loop holds once the event fires
+                break;
+            }
+            case TRAIN_STATUS_LOADING_PASSENGERS:
+            case TRAIN_STATUS_WAITING_FOR_LINK: {
+                tryLink(t, tick);
+                break;
+            }
+            case TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK: {
+                uint32_t link = topo.route_link[route[t]];
+                uint32_t promoted = leavePlatform(link);
+                if (promoted != SOA_NONE) wake(promoted, t, tick);
+                status[t] = TRAIN_STATUS_TRANSITIONING;
+                link_occupied[link] = 1;
+                travel_count[t]--;
+                finish_at[t] = tick + (uint64_t)travel_count[t] + 1;
+                wheel.schedule(finish_at[t], t);
+                travel_count[t] = 0;
+                break;
+            }
+            case TRAIN_STATUS_TRANSITIONING: {
+                uint32_t link = topo.route_link[route[t]];
+                link_occupied[link] = 0;
+                uint32_t waiter = link_waiter[link];
+                if (waiter != SOA_NONE) {
+                    link_waiter[link] = SOA_NONE;
+                    wake(waiter, t, tick);
+                }
+
+                route[t] = topo.route_arrival[route[t]];
+                uint32_t plt = topo.route_link[route[t]];
+                if (platform_occupied[plt]) {
+                    enterPlatformQueue(t, plt);
+                } else {
+                    enterPlatform(t, plt);
+                    status[t] = TRAIN_STATUS_OPENING_DOOR;
+                    wheel.schedule(tick + 1, t);
+                }
+                break;
+            }
+            default: break;     // queueing trains are woken by leavePlatform
+        }
+    }
+};
+
+void simulateEvents(const Network &network,
+                    size_t ticks,
+                    const vector<size_t> &wanted,
+                    size_t num_lines,
+                    DigestRecorder *digest) {
+    SoATopology topo(network);
+    EventEngine engine(topo);
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, STDOUT_FILENO);
+    const size_t max_wanted = wanted.empty() ? 0 : *max_element(wanted.begin(), wanted.end());
+    const size_t spawn_ticks = (max_wanted + 1) / 2;
+    const size_t print_from = num_lines <= ticks ? ticks - num_lines : ticks;
+
+    size_t tick = 0;
+    while (tick < ticks) {
+        engine.runTick(wanted);
+        if (tick >= print_from) {    // print info
+            engine.writeTick(tick, out);
+        }
+        if (digest != nullptr && digest->wants(tick) && !digest->record(tick, engine.canonicalDigest(tick))) {
+            break;
+        }
+
+        size_t next = tick + 1;
+        if (next >= spawn_ticks && next < print_from) {
+            next = min((size_t)engine.nextEventTick(), print_from);
+            if (digest != nullptr) next = min((size_t)digest->nextSample(tick), next);
+        }
+        if (next >= ticks) break;
+        engine.advanceTo(next);
+        tick = next;
+    }
+    flushOrExit(out);
+}
+
+#endif //CS3210_ASSIGNMENT1_EVENT_ENGINE_H
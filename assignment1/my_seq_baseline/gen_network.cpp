@@ -0,0 +1,93 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -fopenmp -o gen_network gen_network.cpp
+ * Run: ./gen_network [--stations=S] [--network-lines=L] [--line-length=MIN:MAX] [--shared-segments=K]
+ *                    [--popularity=MIN:MAX] [--popularity-shape=X] [--distance=MIN:MAX] [--distance-shape=X]
+ *                    [--trains=T] [--ticks=N] [--lines=P] [--seed=SEED] [--format=matrix|sparse|binary] [-o FILE]
+ * Writes a random network in an input format of ./main, to stdout unless -o is given. Use the sparse
+ * or binary format for large networks, the matrix grows with the square of the station count.
+ */
+#include "netgen.h"
+#include "netwriter.h"
+
+// "MIN:MAX" or a single value used as both
+template<typename T>
+bool parseRange(const char *text, T &lo, T &hi) {
+    char *end;
+    unsigned long long a = strtoull(text, &end, 10);
+    if (end == text) return false;
+    unsigned long long b = a;
+    if (*end == ':') {
+        const char *second = end + 1;
+        b = strtoull(second, &end, 10);
+        if (end == second) return false;
+    }
+    if (*end != '\0' || b < a) return false;
+    lo = a;
+    hi = b;
+    return true;
+}
+
+int main(int argc, char const* argv[]) {
+    GeneratorParams params;
+    const char *out_path = nullptr;
+    NETWORK_FORMAT format = NETWORK_FORMAT_MATRIX;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool ok = true;
+        if (arg == "-o" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg.rfind("--stations=", 0) == 0) {
+            params.num_stations = strtoull(arg.c_str() + strlen("--stations="), nullptr, 10);
+        } else if (arg.rfind("--network-lines=", 0) == 0) {
+            params.num_network_lines = strtoull(arg.c_str() + strlen("--network-lines="), nullptr, 10);
+        } else if (arg.rfind("--line-length=", 0) == 0) {
+            ok = parseRange(arg.c_str() + strlen("--line-length="), params.min_line_length, params.max_line_length);
+        } else if (arg.rfind("--shared-segments=", 0) == 0) {
+            params.shared_segments = strtoull(arg.c_str() + strlen("--shared-segments="), nullptr, 10);
+        } else if (arg.rfind("--popularity=", 0) == 0) {
+            ok = parseRange(arg.c_str() + strlen("--popularity="), params.min_popularity, params.max_popularity);
+        } else if (arg.rfind("--popularity-shape=", 0) == 0) {
+            params.popularity_shape = atof(arg.c_str() + strlen("--popularity-shape="));
+        } else if (arg.rfind("--distance=", 0) == 0) {
+            ok = parseRange(arg.c_str() + strlen("--distance="), params.min_distance, params.max_distance);
+        } else if (arg.rfind("--distance-shape=", 0) == 0) {
+            params.distance_shape = atof(arg.c_str() + strlen("--distance-shape="));
+        } else if (arg.rfind("--trains=", 0) == 0) {
+            params.trains_per_line = strtoull(arg.c_str() + strlen("--trains="), nullptr, 10);
+        } else if (arg.rfind("--ticks=", 0) == 0) {
+            params.ticks = strtoull(arg.c_str() + strlen("--ticks="), nullptr, 10);
+        } else if (arg.rfind("--lines=", 0) == 0) {
+            params.num_lines = strtoull(arg.c_str() + strlen("--lines="), nullptr, 10);
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            params.seed = strtoull(arg.c_str() + strlen("--seed="), nullptr, 10);
+        } else if (arg.rfind("--format=", 0) == 0) {
+            ok = parseNetworkFormat(arg.substr(strlen("--format=")), format);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            cerr << "Bad option " << arg << '\n';
+            exit(1);
+        }
+    }
+    if (params.num_network_lines == 0) {
+        cerr << "--network-lines must be at least 1\n";
+        exit(1);
+    }
+
+    NetworkSpec spec;
+    NetworkGenerator(params).generate(spec);
+
+    FILE *f = out_path != nullptr ? fopen(out_path, "wb") : stdout;
+    if (f == nullptr) {
+        cerr << "Failed to open " << out_path << '\n';
+        exit(2);
+    }
+    bool ok = writeNetwork(f, spec, format);
+    ok = (f == stdout ? fflush(f) == 0 : fclose(f) == 0) && ok;
+    if (!ok) {
+        cerr << "Failed to write the network\n";
+        exit(2);
+    }
+    return 0;
+}
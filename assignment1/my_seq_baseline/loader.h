@@ -0,0 +1,446 @@
+#ifndef CS3210_ASSIGNMENT1_LOADER_H
+#define CS3210_ASSIGNMENT1_LOADER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <omp.h>
+using namespace std;
+
+/* Zero-copy loader for the assignment input format.
+ *
+ * The file is memory-mapped and scanned in place. The S x S adjacency matrix is by far the largest
+ * part of the file, so for big networks it is parsed by several threads: a first pass counts the
+ * tokens of each chunk, the prefix sums give every chunk the matrix cell its first token belongs to,
+ * and a second pass parses the chunks independently. Links come out in row-major order either way,
+ * which is the order link ids were always given in.
+ *
+ * Besides the assignment's three lines, any number of line rows may follow the matrix, each
+ * optionally starting with "label:". The row after N then holds one train count per line. N, the
+ * counts and the number of printed ticks are the last three rows, which is how the line rows end.
+ *
+ * Two more formats avoid the O(S^2) matrix and are told apart by their first bytes:
+ *   sparse text  the word "sparse", then "S E" instead of S, and E rows "src dst distance" (station
+ *                indices) instead of the matrix; everything else as above
+ *   binary       NetworkFileHeader, then the arrays listed there, in native byte order
+ * convert_network translates between all three. */
+
+struct EdgeSpec {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t distance;
+};
+
+// Everything the input file describes, before any simulation object is built.
+struct NetworkSpec {
+    vector<string> station_names;
+    vector<uint32_t> popularity;
+    vector<EdgeSpec> edges;                 // nonzero matrix cells, row-major
+    vector<string> line_labels;             // train name prefix of each line
+    vector<vector<string>> lines;           // station names of each line
+    size_t ticks;
+    vector<size_t> num_trains;              // per line
+    size_t num_lines;
+};
+
+// Lines without an explicit label: the assignment's green, yellow and blue, then l3_, l4_, ... (the
+// separator keeps "l12_3-" apart from "l1_23-")
+inline string defaultLineLabel(size_t index) {
+    static const char *const classic[] = {"g", "y", "b"};
+    return index < 3 ? classic[index] : "l" + to_string(index) + "_";
+}
+
+#define NETWORK_MAGIC "MRTNETB"
+#define NETWORK_VERSION 1
+#define SPARSE_KEYWORD "sparse"
+
+/* Binary layout, each array right after the previous one without padding:
+ *   name_end        uint64 x S      end of each station name in the name pool
+ *   name pool       char x name_bytes
+ *   popularity      uint32 x S
+ *   row_begin       uint64 x (S + 1) CSR: the links leaving station s are row_begin[s] .. row_begin[s + 1]
+ *   edge_dst        uint32 x E
+ *   edge_distance   uint32 x E
+ *   label_end       uint64 x L      end of each line label in the label pool
+ *   label pool      char x label_bytes
+ *   line_end        uint64 x L      end of each line in line_station
+ *   line_station    uint32 x line_stations
+ *   num_trains      uint64 x L */
+struct NetworkFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_network_lines;         // L
+    uint64_t num_stations;              // S
+    uint64_t num_edges;                 // E
+    uint64_t name_bytes;
+    uint64_t label_bytes;
+    uint64_t line_stations;
+    uint64_t ticks;
+    uint64_t num_lines;                 // printed ticks
+};
+
+class MappedFile {
+public:
+    MappedFile() {
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    ~MappedFile() {
+        if (this->data != nullptr && this->size > 0) munmap((void *)this->data, this->size);
+    }
+
+    // advice is for madvise, queries jumping around the file pass MADV_RANDOM
+    bool open(const char *path, int advice = MADV_SEQUENTIAL) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            close(fd);
+            return false;
+        }
+        this->size = st.st_size;
+        if (this->size > 0) {
+            void *p = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+            madvise(p, this->size, advice);
+            this->data = (const char *)p;
+        }
+        close(fd);
+        return true;
+    }
+
+    const char *begin() const {
+        return this->data;
+    }
+
+    const char *end() const {
+        return this->data + this->size;
+    }
+
+    size_t length() const {
+        return this->size;
+    }
+
+private:
+    const char *data;
+    size_t size;
+};
+
+/* scanner begin */
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline void skipSpace(const char *&p, const char *end) {
+    while (p < end && isSpace(*p)) ++p;
+}
+
+inline uint64_t parseUnsigned(const char *&p, const char *end) {
+    skipSpace(p, end);
+    uint64_t v = 0;
+    unsigned d;
+    while (p < end && (d = (unsigned)(*p - '0')) < 10) {
+        v = v * 10 + d;
+        ++p;
+    }
+    return v;
+}
+
+inline string parseWord(const char *&p, const char *end) {
+    skipSpace(p, end);
+    const char *start = p;
+    while (p < end && !isSpace(*p)) ++p;
+    return string(start, p - start);
+}
+
+inline size_t countTokens(const char *p, const char *end) {
+    size_t count = 0;
+    bool prev_space = true;
+    for (; p < end; ++p) {
+        bool space = isSpace(*p);
+        count += prev_space & !space;
+        prev_space = space;
+    }
+    return count;
+}
+/* scanner end */
+
+const size_t PARALLEL_PARSE_MIN_STATIONS = 1024;
+
+// Parses the S x S matrix starting at p, leaves p right after its last cell.
+inline void parseAdjacency(const char *&p, const char *end, size_t S, vector<EdgeSpec> &edges) {
+    const size_t cells = S * S;
+    int nth = S >= PARALLEL_PARSE_MIN_STATIONS ? omp_get_max_threads() : 1;
+
+    // chunk boundaries, moved forward to whitespace so no token is split
+    vector<const char *> bounds(nth + 1);
+    for (int i = 0; i <= nth; ++i) {
+        const char *b = p + (end - p) * i / nth;
+        while (b < end && b > p && !isSpace(*b)) ++b;
+        bounds[i] = b;
+    }
+
+    // pass 1: tokens per chunk
+    vector<size_t> first_cell(nth + 1, 0);
+#pragma omp parallel for num_threads(nth) schedule(static, 1)
+    for (int i = 0; i < nth; ++i) {
+        first_cell[i + 1] = countTokens(bounds[i], bounds[i + 1]);
+    }
+    for (int i = 0; i < nth; ++i) first_cell[i + 1] += first_cell[i];
+
+    // pass 2: parse the cells of each chunk
+    vector<vector<EdgeSpec>> chunk_edges(nth);
+    vector<const char *> chunk_end(nth);
+#pragma omp parallel for num_threads(nth) schedule(static, 1)
+    for (int i = 0; i < nth; ++i) {
+        const char *q = bounds[i];
+        size_t cell = first_cell[i];
+        while (cell < cells && cell < first_cell[i + 1]) {
+            uint64_t distance = parseUnsigned(q, bounds[i + 1]);
+            if (distance > 0) chunk_edges[i].push_back({(uint32_t)(cell / S), (uint32_t)(cell % S), (uint32_t)distance});
+            ++cell;
+        }
+        chunk_end[i] = q;
+    }
+
+    for (int i = 0; i < nth; ++i) {
+        edges.insert(edges.end(), chunk_edges[i].begin(), chunk_edges[i].end());
+        if (first_cell[i] < cells) p = chunk_end[i];
+    }
+}
+
+// Station names and popularities, the same in both text formats.
+inline void parseStations(const char *&p, const char *end, size_t S, NetworkSpec &spec) {
+    // Read station names.
+    spec.station_names.reserve(S);
+    for (size_t i = 0; i < S; ++i) spec.station_names.push_back(parseWord(p, end));
+
+    // Read P popularity
+    spec.popularity.reserve(S);
+    for (size_t i = 0; i < S; ++i) spec.popularity.push_back(parseUnsigned(p, end));
+}
+
+// E rows "src dst distance", sorted into row-major order afterwards.
+inline bool parseEdgeList(const char *&p, const char *end, const char *path, size_t S, size_t E,
+                          vector<EdgeSpec> &edges) {
+    edges.reserve(E);
+    for (size_t i = 0; i < E; ++i) {
+        uint64_t src = parseUnsigned(p, end), dst = parseUnsigned(p, end), distance = parseUnsigned(p, end);
+        if (src >= S || dst >= S || distance == 0) {
+            cerr << path << ": bad edge " << src << ' ' << dst << ' ' << distance << '\n';
+            return false;
+        }
+        edges.push_back({(uint32_t)src, (uint32_t)dst, (uint32_t)distance});
+    }
+    sort(edges.begin(), edges.end(), [](const EdgeSpec &a, const EdgeSpec &b) {
+        return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+    });
+    for (size_t i = 1; i < edges.size(); ++i) {
+        if (edges[i].src == edges[i - 1].src && edges[i].dst == edges[i - 1].dst) {
+            cerr << path << ": edge " << edges[i].src << ' ' << edges[i].dst << " given twice\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Line rows, N, the train counts and the number of printed ticks, which follow the links in both
+// text formats.
+inline bool parseLinesAndRun(const char *&p, const char *end, const char *path, NetworkSpec &spec) {
+    // Station names of different lines, one line of the file each. N, the train counts and the number
+    // of printed ticks are always the last three rows, so every row before them is a line, whatever
+    // its first character. A row may start with "label:" to name the line.
+    while (p < end && *p != '\n') ++p;
+    vector<const char *> rows;          // row starts, plus where the last row ends
+    for (const char *q = p; q < end;) {
+        rows.push_back(++q);
+        const char *eol = (const char *)memchr(q, '\n', end - q);
+        q = eol != nullptr ? eol : end;
+    }
+    rows.push_back(end);
+    while (rows.size() > 1) {           // trailing blank rows
+        const char *q = rows[rows.size() - 2];
+        skipSpace(q, rows.back());
+        if (q < rows.back()) break;
+        rows.pop_back();
+    }
+    size_t num_rows = rows.size() - 1, line_rows = num_rows >= 3 ? num_rows - 3 : 0;
+
+    for (size_t r = 0; r < line_rows; ++r) {
+        const char *q = rows[r], *eol = rows[r + 1] - 1;
+        vector<string> line;
+        string label = defaultLineLabel(spec.lines.size());
+        bool first = true;
+        while (true) {
+            skipSpace(q, eol);
+            if (q >= eol) break;
+            string word = parseWord(q, eol);
+            if (first && word.size() > 1 && word.back() == ':') {
+                label = word.substr(0, word.size() - 1);
+            } else {
+                line.push_back(word);
+            }
+            first = false;
+        }
+        spec.line_labels.push_back(label);
+        spec.lines.push_back(line);
+    }
+    p = rows[line_rows];
+
+    spec.ticks = parseUnsigned(p, end);
+
+    // one train count per line, on the row after N
+    while (p < end && *p != '\n') ++p;
+    if (p < end) ++p;
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    if (eol == nullptr) eol = end;
+    while (true) {
+        skipSpace(p, eol);
+        if (p >= eol) break;
+        spec.num_trains.push_back(parseUnsigned(p, eol));
+    }
+    if (spec.num_trains.size() > spec.lines.size()) {
+        cerr << path << ": " << spec.num_trains.size() << " train counts for " << spec.lines.size() << " lines\n";
+        return false;
+    }
+    spec.num_trains.resize(spec.lines.size(), 0);
+    spec.num_lines = parseUnsigned(p, end);
+    return true;
+}
+
+// Bounds-checked reads of the binary format; the arrays are not aligned, so they are copied out.
+class BinaryCursor {
+public:
+    BinaryCursor(const char *p, const char *end) : p(p), end(end) {}
+
+    template<typename T>
+    bool take(vector<T> &a, uint64_t n) {
+        if (n > (uint64_t)(this->end - this->p) / sizeof(T)) return false;
+        a.resize(n);
+        memcpy(a.data(), this->p, n * sizeof(T));
+        this->p += n * sizeof(T);
+        return true;
+    }
+
+    bool take(string &s, uint64_t n) {
+        if (n > (uint64_t)(this->end - this->p)) return false;
+        s.assign(this->p, n);
+        this->p += n;
+        return true;
+    }
+
+private:
+    const char *p;
+    const char *end;
+};
+
+// Cuts a pool into pieces ending at the given offsets.
+inline bool splitPool(const string &pool, const vector<uint64_t> &ends, vector<string> &pieces) {
+    uint64_t begin = 0;
+    pieces.reserve(ends.size());
+    for (uint64_t e: ends) {
+        if (e < begin || e > pool.size()) return false;
+        pieces.push_back(pool.substr(begin, e - begin));
+        begin = e;
+    }
+    return true;
+}
+
+// False if the arrays do not fit the file or each other; the header has been checked already.
+inline bool parseBinaryNetwork(const MappedFile &file, NetworkSpec &spec) {
+    NetworkFileHeader h;
+    memcpy(&h, file.begin(), sizeof(h));
+    BinaryCursor in(file.begin() + sizeof(h), file.end());
+    const uint64_t S = h.num_stations, E = h.num_edges, L = h.num_network_lines;
+    vector<uint64_t> name_end, row_begin, label_end, line_end, num_trains;
+    vector<uint32_t> edge_dst, edge_distance, line_station;
+    string names, labels;
+    bool ok = in.take(name_end, S) && in.take(names, h.name_bytes) && in.take(spec.popularity, S)
+              && in.take(row_begin, S + 1) && in.take(edge_dst, E) && in.take(edge_distance, E)
+              && in.take(label_end, L) && in.take(labels, h.label_bytes) && in.take(line_end, L)
+              && in.take(line_station, h.line_stations) && in.take(num_trains, L)
+              && splitPool(names, name_end, spec.station_names) && splitPool(labels, label_end, spec.line_labels)
+              && row_begin[0] == 0 && row_begin[S] == E;
+    if (!ok) return false;
+
+    spec.edges.reserve(E);
+    for (uint64_t s = 0; s < S; ++s) {
+        if (row_begin[s + 1] < row_begin[s] || row_begin[s + 1] > E) return false;
+        for (uint64_t e = row_begin[s]; e < row_begin[s + 1]; ++e) {
+            if (edge_dst[e] >= S || edge_distance[e] == 0) return false;
+            spec.edges.push_back({(uint32_t)s, edge_dst[e], edge_distance[e]});
+        }
+    }
+
+    uint64_t begin = 0;
+    spec.lines.resize(L);
+    for (uint64_t l = 0; l < L; ++l) {
+        if (line_end[l] < begin || line_end[l] > line_station.size()) return false;
+        for (uint64_t i = begin; i < line_end[l]; ++i) {
+            if (line_station[i] >= S) return false;
+            spec.lines[l].push_back(spec.station_names[line_station[i]]);
+        }
+        begin = line_end[l];
+    }
+    spec.ticks = h.ticks;
+    spec.num_trains.assign(num_trains.begin(), num_trains.end());
+    spec.num_lines = h.num_lines;
+    return true;
+}
+
+inline bool loadNetworkSpec(const char *path, NetworkSpec &spec) {
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    const char *p = file.begin(), *end = file.end();
+
+    if (file.length() >= sizeof(NETWORK_MAGIC) && memcmp(p, NETWORK_MAGIC, sizeof(NETWORK_MAGIC)) == 0) {
+        NetworkFileHeader h;
+        if (file.length() < sizeof(h)) {
+            cerr << path << ": truncated binary network\n";
+            return false;
+        }
+        memcpy(&h, p, sizeof(h));
+        if (h.version != NETWORK_VERSION) {
+            cerr << path << ": binary network version " << h.version << ", expected " << NETWORK_VERSION << '\n';
+            return false;
+        }
+        if (!parseBinaryNetwork(file, spec)) {
+            cerr << path << ": truncated or inconsistent binary network\n";
+            return false;
+        }
+        return true;
+    }
+
+    skipSpace(p, end);
+    if (p < end && (unsigned)(*p - '0') >= 10) {
+        if (parseWord(p, end) != SPARSE_KEYWORD) {
+            cerr << path << ": unknown input format\n";
+            return false;
+        }
+        size_t S = parseUnsigned(p, end), E = parseUnsigned(p, end);
+        parseStations(p, end, S, spec);
+        return parseEdgeList(p, end, path, S, E, spec.edges) && parseLinesAndRun(p, end, path, spec);
+    }
+
+    // Read S
+    size_t S = parseUnsigned(p, end);
+    parseStations(p, end, S, spec);
+    parseAdjacency(p, end, S, spec.edges);
+    return parseLinesAndRun(p, end, path, spec);
+}
+
+#endif //CS3210_ASSIGNMENT1_LOADER_H
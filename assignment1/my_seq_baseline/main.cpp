@@ -1,21 +1,84 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -fopenmp -pthread -o main main.cpp
+ * Run: ./main <input_file> [--engine=tick|soa|event|parallel|components|regions] [--threads=N] [--regions=N]
+ *             [--fast-forward[=K]] [--checkpoint=FILE [--save-at=T] [--save-every=K]] [--resume=FILE]
+ *             [--batch=JOBS_FILE [--batch-out=DIR]] [--ensemble=JOBS_FILE [--lanes=K] [--batch-out=DIR]]
+ *             [--stats=FILE] [--profile=FILE] [--digest=FILE] [--digest-compare=FILE] [--digest-every=K]
+ *             [--passengers=FILE [--demand=X] [--train-capacity=N] [--board-rate=N]]
+ *             [--record-base=DIR [--snapshot-every=K]] [--what-if=DIR] [--telemetry=FILE [--telemetry-every=K]]
+ *             [--delta-trace=FILE]
+ *      ./main --bench [--engine=...] [--threads=N] [--regions=N] [--fast-forward[=K]] [--bench-stations=S1,S2,...]
+ *             [--bench-trains=T1,T2,...] [--bench-lines=L] [--bench-ticks=N] [--bench-seed=SEED]
+ * Statistics (--stats, tick engine only) need a build with -DMRT_STATS. Passengers are simulated by
+ * the tick engine only. --record-base and --what-if need --engine=soa, see whatif.h. The input file may
+ * be in the matrix, sparse or binary format (see loader.h); convert_network converts between them.
+ * --ensemble runs the jobs of a batch file K at a time in SIMD lanes, see ensemble.h. --telemetry
+ * (--engine=soa) publishes progress to shared memory keyed by FILE, watch it with ./monitor FILE.
+ * --delta-trace (--engine=soa) writes the printed ticks to FILE as transitions only, see delta_trace.h;
+ * ./decode_trace FILE prints them as usual, ./query_trace answers position queries on them.
+ */
 #include "main.h"
+#include "soa_engine.h"
+#include "soa_run.h"
+#include "event_engine.h"
+#include "parallel_engine.h"
+#include "components.h"
+#include "region_engine.h"
+#include "batch.h"
+#include "ensemble.h"
+#include "stats.h"
+#include "profile.h"
+#include "bench.h"
+#include "digest.h"
+#include "passengers.h"
+#include "whatif.h"
+#include "loader.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
 #include <sys/time.h>
 
-Train::Train(unsigned id, MRT_LINE line, Station *location) {
+Platform *Station::addLinkTowards(Station *dst, Link *link, Arena &arena) {
+    Platform *plt = arena.create<Platform>(link->getId(), this, dst);
+    this->links.push_back(link);
+    this->platforms.push_back(plt);
+    return plt;
+}
+
+Platform *Station::getTargetPlatform(Station *dst_station) {
+    for (unsigned i = 0; i < this->links.size(); ++i) {
+        if (this->links[i]->getDstStation() == dst_station) return this->platforms[i];
+    }
+    return nullptr;
+}
+
+Link *Station::getTargetLink(Station *dst_station) {
+    for (Link *link: this->links) {
+        if (link->getDstStation() == dst_station) return link;
+    }
+    return nullptr;
+}
+
+Train::Train(unsigned id, unsigned line, LineStationsManager *manager, unsigned line_pos) {
     this->train_id = id;
     this->line = line;
+    this->manager = manager;
     this->status = TRAIN_STATUS_INITIAL;
-    this->station_at = location;
-    this->direction = this->lineStationsManager()->isStartingStation(location) ? DIRECTION_FORWARD : DIRECTION_BACKWARD;
-    this->load_passengers_counter = new TimeCounter();
-    this->travel_link_counter = new TimeCounter();
+    this->direction = line_pos == 0 ? DIRECTION_FORWARD : DIRECTION_BACKWARD;
+    this->route = this->lineStationsManager()->routeAt(LineStationsManager::routeIndex(line_pos, this->direction));
+    this->station_at = this->route->station;
+    this->next_in_queue = nullptr;
+    this->passengers = nullptr;
 }
 
 void Train::enterPlatform(class Platform * plt) {
+    MRT_STAT(this->stats->platformEntered(plt->getId(), plt->getStation()->getId(),
+                                          this->status == TRAIN_STATUS_QUEUEING_FOR_PLATFORM, this->queued_since));
     this->setCurrentStatus(TRAIN_STATUS_IN_PLATFORM);
     this->station_at = plt->getStation();
     this->platform_at = plt;
-    this->load_passengers_counter->setCounter(plt->getStation()->getPopularity());        // prepare for loading passengers
+    this->load_passengers_counter.setCounter(plt->getStation()->getPopularity());        // prepare for loading passengers
+    if (this->passengers != nullptr) this->passengers->alight(this->train_id, plt->getStation()->getId());
 
     plt->setOccupied(true);
 }
@@ -23,13 +86,17 @@ void Train::enterPlatform(class Platform * plt) {
 void Train::enterPlatformQueue(class Platform * plt) {
     this->setCurrentStatus(TRAIN_STATUS_QUEUEING_FOR_PLATFORM);
     plt->addTrainToHoldingArea(this);
+    MRT_STAT(this->queued_since = this->stats->tick);
+    MRT_STAT(this->stats->queueChanged(plt->getId(), +1));
 }
 
 void Train::leavePlatform(class Platform * plt) {
     plt->setOccupied(false);
+    MRT_STAT(this->stats->platformLeft(plt->getId()));
 
     if (!plt->holding_area.empty()) {       // notify trains in queue
         Train *firstTrain = plt->holding_area.front();
+        MRT_STAT(this->stats->queueChanged(plt->getId(), -1));
         firstTrain->enterPlatform(plt);
         plt->holding_area.pop_front();
     }
@@ -41,15 +108,19 @@ void Train::openDoor() {
 
 void Train::loadPassengersFromStation(class Station * st) {
     this->setCurrentStatus(TRAIN_STATUS_LOADING_PASSENGERS);
-    this->load_passengers_counter->count();
+    this->load_passengers_counter.count();
+    if (this->passengers != nullptr) {
+        this->passengers->board(this->train_id, this->route - this->lineStationsManager()->routeAt(0));
+    }
 }
 
 
 void Train::waitForAnotherTikToLink(class Link * link) {
     // last preparation before entering link
     this->setCurrentStatus(TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK);
-    this->travel_link_counter->setCounter(link->getDistance());       // prepare for transitioning
+    this->travel_link_counter.setCounter(link->getDistance());       // prepare for transitioning
     link->setOccupied(true);
+    MRT_STAT(this->stats->linkTaken(link->getId()));
 }
 
 void Train::waitForLink() {
@@ -60,108 +131,129 @@ void Train::enterLink(class Link * link) {
     this->setCurrentStatus(TRAIN_STATUS_TRANSITIONING);
     this->link_at = link;
     link->setOccupied(true);
+    if (this->passengers != nullptr) this->passengers->departed(this->train_id, link->getDistance());
+    MRT_STAT(this->stats->linkTaken(link->getId()));
 }
 
 void Train::leaveLink(class Link * link) {
     link->setOccupied(false);
+    MRT_STAT(this->stats->linkReleased(link->getId()));
 }
 
 void Train::transition() {
-    this->travel_link_counter->count();
+    this->travel_link_counter.count();
 }
 
 void Train::turnAround() {
     this->direction = (direction == DIRECTION_FORWARD) ? DIRECTION_BACKWARD : DIRECTION_FORWARD;
 }
 
-string Train::currentInfo() {
-    string info;
-    switch (this->line) {
-        case MRT_LINE_GREEN: info += "g"; break;
-        case MRT_LINE_YELLOW: info += "y"; break;
-        case MRT_LINE_BLUE: info += "b"; break;
+void Train::advanceRoute() {
+    // called once the train has reached the next station of its current route
+    if (this->route->turnaround) {
+        this->turnAround();
     }
-    info += to_string(this->train_id);
-    info += "-";
+    this->route = this->lineStationsManager()->routeAt(this->route->arrival);
+}
+
+void Train::writeInfo(TraceFormatter &out) {
     if (this->status == TRAIN_STATUS_TRANSITIONING) {
-        info += (this->link_at->getSrcStation()->getName());
-        info += "->";
-        info += (this->link_at->getDstStation()->getName());
+        out.trainOnLink(this->train_id, this->link_at->getId());
     } else {
-        info += (this->station_at->getName());
+        out.trainAtStation(this->train_id, this->station_at->getId());
     }
+}
 
-    return info;
+void spawnTrainOnLine(Arena& train_arena, unsigned line_pos, unsigned line, LineStationsManager *manager, unsigned& id_counter, vector<Train*>& trains, vector<unsigned>& train_ids, [[maybe_unused]] SimStats *stats) {
+    Train *train = train_arena.create<Train>(id_counter++, line, manager, line_pos);
+    MRT_STAT(train->attachStats(stats));
+    Platform *target_plt = train->currentRoute()->target_platform;
+    target_plt->isOccupied() ? train->enterPlatformQueue(target_plt) : train->enterPlatform(target_plt);
+
+    trains.push_back(train);
+    train_ids.push_back(train->getId());
 }
 
-void spawnTrainsOnLine(int num, vector<Station*>& line_sts, MRT_LINE line, unsigned& id_counter, vector<Train*>& trains, vector<unsigned>& train_ids) {
+void spawnTrainsOnLine(Arena& train_arena, int num, Network& network, unsigned line, unsigned& id_counter, vector<Train*>& trains, vector<unsigned>& train_ids, SimStats *stats) {
+    LineStationsManager *manager = network.lines[line].manager;
     if (num == 1) {
-        Train *train = new Train(id_counter++, line, line_sts[0]);
-        Station *next_station = train->lineStationsManager()->getNextStationOfDirection(train->currentStation(), train->currentDirection());
-        Platform *target_plt = train->currentStation()->getTargetPlatform(next_station);
-        target_plt->isOccupied() ? train->enterPlatformQueue(target_plt) : train->enterPlatform(target_plt);
-
-        trains.push_back(train);
-        train_ids.push_back(train->getId());
+        spawnTrainOnLine(train_arena, 0, line, manager, id_counter, trains, train_ids, stats);
     } else if (num == 2) {
-        Train *train_at_start = new Train(id_counter++, line, line_sts[0]);
-        Station *second_st = train_at_start->lineStationsManager()->getNextStationOfDirection(train_at_start->currentStation(), train_at_start->currentDirection());
-        Platform *target_plt_of_train_at_start = train_at_start->currentStation()->getTargetPlatform(second_st);
-        target_plt_of_train_at_start->isOccupied() ? train_at_start->enterPlatformQueue(target_plt_of_train_at_start) : train_at_start->enterPlatform(target_plt_of_train_at_start);
-
-        trains.push_back(train_at_start);
-        train_ids.push_back(train_at_start->getId());
-
-        Train *train_at_terminal = new Train(id_counter++, line, line_sts[line_sts.size() - 1]);
-        Station *second_last_st = train_at_terminal->lineStationsManager()->getNextStationOfDirection(train_at_terminal->currentStation(), train_at_terminal->currentDirection());
-        Platform *target_plt_of_train_at_terminal = train_at_terminal->currentStation()->getTargetPlatform(second_last_st);
-        target_plt_of_train_at_terminal->isOccupied() ? train_at_terminal->enterPlatformQueue(target_plt_of_train_at_terminal) : train_at_terminal->enterPlatform(target_plt_of_train_at_terminal);
+        spawnTrainOnLine(train_arena, 0, line, manager, id_counter, trains, train_ids, stats);                                            // train at start
+        spawnTrainOnLine(train_arena, network.lines[line].stations.size() - 1, line, manager, id_counter, trains, train_ids, stats);    // train at terminal
+    }
+}
 
-        trains.push_back(train_at_terminal);
-        train_ids.push_back(train_at_terminal->getId());
+// Canonical state digest of the Train* engine, see trainStateDigest().
+uint64_t trainsDigest(Network& network, const vector<Train*>& trains) {
+    uint64_t sum = 0;
+    for (Train* train: trains) {
+        unsigned route = train->currentRoute() - train->lineStationsManager()->routeAt(0);
+        sum += trainStateDigest(train->getId(), train->currentStatus(), train->getLine(), route,
+                                train->currentStation()->getId(), train->getLoadingCounter()->remaining(),
+                                train->getTravelingCounter()->remaining());
     }
+    for (Platform* plt: network.platforms) {
+        bool link_occupied = network.links[plt->getId()]->isOccupied();
+        Train *queued = plt->firstInHoldingArea();
+        if (!plt->isOccupied() && !link_occupied && queued == nullptr) continue;
+        uint64_t h = platformStateSeed(plt->getId(), plt->isOccupied(), link_occupied);
+        for (; queued != nullptr; queued = queued->nextInQueue()) h = mixHash(h, queued->getId());
+        sum += h;
+    }
+    return sum;
 }
 
-void simulate(const unordered_map<string, Station*>& stations,
+void simulate(Network& network,
             size_t ticks,
-            size_t num_green_trains,
-            size_t num_yellow_trains,
-            size_t num_blue_trains,
-            size_t num_lines) {
+            const vector<size_t>& wanted,
+            size_t num_lines,
+            SimStats *stats,        // only used in MRT_STATS builds
+            RunProfile *profile,
+            DigestRecorder *digest,
+            PassengerFlow *passengers) {
+
+#ifdef MRT_STATS
+    SimStats local_stats(network);      // collected but not reported when the caller passes none
+    if (stats == nullptr) stats = &local_stats;
+#endif
 
     unsigned tick_counter = 0, train_id_counter = 0;
-    unsigned cur_green_trains = 0, cur_yellow_trains = 0, cur_blue_trains = 0;
+    vector<size_t> cur_trains(network.numLines(), 0);
 
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, STDOUT_FILENO);
+
+    Arena train_arena;      // all trains of this run, freed together on return
     vector<Train*> trains;
-    vector<unsigned> green_train_ids, yellow_train_ids, blue_train_ids;
+    vector<vector<unsigned>> line_train_ids(network.numLines());
+    PhaseClock clock(profile);
+    size_t status_counts[NUM_TRAIN_STATUSES];
 
     while (tick_counter < ticks) {
+        MRT_STAT(stats->tick = tick_counter);
 
         // spawn trains
-        if (cur_green_trains + 2 <= num_green_trains) {
-            spawnTrainsOnLine(2, green_line, MRT_LINE_GREEN, train_id_counter, trains, green_train_ids);
-            cur_green_trains += 2;
-        } else if (cur_green_trains + 1 <= num_green_trains) {
-            spawnTrainsOnLine(1, green_line, MRT_LINE_GREEN, train_id_counter, trains, green_train_ids);
-            cur_green_trains++;
-        }
-
-        if (cur_yellow_trains + 2 <= num_yellow_trains) {
-            spawnTrainsOnLine(2, yellow_line, MRT_LINE_YELLOW, train_id_counter, trains, yellow_train_ids);
-            cur_yellow_trains += 2;
-        } else if (cur_yellow_trains + 1 <= num_yellow_trains) {
-            spawnTrainsOnLine(1, yellow_line, MRT_LINE_YELLOW, train_id_counter, trains, yellow_train_ids);
-            cur_yellow_trains++;
+        size_t spawned_before = trains.size();
+        for (unsigned l = 0; l < network.numLines(); ++l) {
+            if (cur_trains[l] + 2 <= wanted[l]) {
+                spawnTrainsOnLine(train_arena, 2, network, l, train_id_counter, trains, line_train_ids[l], stats);
+                cur_trains[l] += 2;
+            } else if (cur_trains[l] + 1 <= wanted[l]) {
+                spawnTrainsOnLine(train_arena, 1, network, l, train_id_counter, trains, line_train_ids[l], stats);
+                cur_trains[l]++;
+            }
         }
-
-        if (cur_blue_trains + 2 <= num_blue_trains) {
-            spawnTrainsOnLine(2, blue_line, MRT_LINE_BLUE, train_id_counter, trains, blue_train_ids);
-            cur_blue_trains += 2;
-        } else if (cur_blue_trains + 1 <= num_blue_trains) {
-            spawnTrainsOnLine(1, blue_line, MRT_LINE_BLUE, train_id_counter, trains, blue_train_ids);
-            cur_blue_trains++;
+        if (passengers != nullptr) {
+            for (size_t i = spawned_before; i < trains.size(); ++i) {
+                trains[i]->attachPassengers(passengers);
+                passengers->addTrain(trains[i]->getId(), trains[i]->getLine());
+            }
         }
+        clock.lap(PHASE_SPAWN);
 
+        if (passengers != nullptr) passengers->generate();
         for (Train* train: trains) {
             switch (train->currentStatus()) {
                 case TRAIN_STATUS_INITIAL: {
@@ -182,8 +274,7 @@ void simulate(const unordered_map<string, Station*>& stations,
                 }
                 case TRAIN_STATUS_LOADING_PASSENGERS: {
                     if (train->getLoadingCounter()->finish()) {
-                        Station *next_station = train->lineStationsManager()->getNextStationOfDirection(train->currentStation(), train->currentDirection());
-                        Link *target_link = train->currentStation()->getTargetLink(next_station);
+                        Link *target_link = train->currentRoute()->target_link;
 
                         if (!target_link->isOccupied()) {
                             train->waitForAnotherTikToLink(target_link);
@@ -196,8 +287,7 @@ void simulate(const unordered_map<string, Station*>& stations,
                     break;
                 }
                 case TRAIN_STATUS_WAITING_FOR_LINK: {
-                    Station *next_station = train->lineStationsManager()->getNextStationOfDirection(train->currentStation(), train->currentDirection());
-                    Link *target_link = train->currentStation()->getTargetLink(next_station);
+                    Link *target_link = train->currentRoute()->target_link;
                     if (!target_link->isOccupied()) {
                         train->waitForAnotherTikToLink(target_link);
                     }
@@ -205,8 +295,7 @@ void simulate(const unordered_map<string, Station*>& stations,
                 }
 
                 case TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK: {
-                    Station *next_station = train->lineStationsManager()->getNextStationOfDirection(train->currentStation(), train->currentDirection());
-                    Link *target_link = train->currentStation()->getTargetLink(next_station);
+                    Link *target_link = train->currentRoute()->target_link;
                     train->leavePlatform(train->currentPlatform());
                     train->enterLink(target_link);
                     train->transition();
@@ -215,13 +304,8 @@ void simulate(const unordered_map<string, Station*>& stations,
 
                 case TRAIN_STATUS_TRANSITIONING: {
                     if (train->getTravelingCounter()->finish()) {
-                        Station *dst_station = train->currentLink()->getDstStation();
-                        if ((train->currentDirection() == DIRECTION_FORWARD && train->lineStationsManager()->isTerminalStation(dst_station))
-                            || (train->currentDirection() == DIRECTION_BACKWARD && train->lineStationsManager()->isStartingStation(dst_station))) {
-                            train->turnAround();        // train turn around
-                        }
-                        Station *next_st_of_dst_st = train->lineStationsManager()->getNextStationOfDirection(dst_station, train->currentDirection());
-                        Platform *target_platform = dst_station->getTargetPlatform(next_st_of_dst_st);
+                        train->advanceRoute();          // turns the train around at either end of the line
+                        Platform *target_platform = train->currentRoute()->target_platform;
 
                         train->leaveLink(train->currentLink());
                         if (target_platform->isOccupied()) {
@@ -239,29 +323,33 @@ void simulate(const unordered_map<string, Station*>& stations,
                 default: cout<<"Unexpected status of train id "<<train->getId()<<endl; break;
             }
         }
+        if (profile != nullptr) {
+            fill(status_counts, status_counts + NUM_TRAIN_STATUSES, 0);
+            for (Train* train: trains) status_counts[train->currentStatus()]++;
+            profile->sampleTick(status_counts);
+        }
+        if (digest != nullptr && digest->wants(tick_counter) && !digest->record(tick_counter, trainsDigest(network, trains))) {
+            break;
+        }
+        clock.lap(PHASE_UPDATE);
 
         if (tick_counter >= ticks - num_lines) {    // print info
-            string info;
-            info += (to_string(tick_counter) + ": ");
-            for (unsigned b_id: blue_train_ids) {
-                info += trains[b_id]->currentInfo();
-                info += " ";
-            }
-            for (unsigned g_id: green_train_ids) {
-                info += trains[g_id]->currentInfo();
-                info += " ";
-            }
-            for (unsigned y_id: yellow_train_ids) {
-                info += trains[y_id]->currentInfo();
-                info += " ";
+            out.beginTick(tick_counter);
+            for (unsigned l: network.print_order) {
+                for (unsigned id: line_train_ids[l]) {
+                    trains[id]->writeInfo(out);
+                }
             }
-            info = info.substr(0, info.size() - 1);
-            cout<<info<<endl;
+            out.endTick();
+            clock.lap(PHASE_FORMAT);
         }
 
         tick_counter++;
     }
 
+    flushOrExit(out);
+    clock.lap(PHASE_FORMAT);
+    if (profile != nullptr) profile->moveToFlush(out.flushNanos());
 }
 
 long long wall_clock_time()
@@ -277,108 +365,453 @@ long long wall_clock_time()
 #endif
 }
 
-int main(int argc, char const* argv[]) {
-
-    if (argc < 2) {
-        cerr << argv[0] << " <input_file>\n";
-        exit(1);
+void Network::build(const NetworkSpec& spec) {
+    for (size_t i = 0; i < spec.station_names.size(); ++i) {
+        string station_name = spec.station_names[i];
+        auto *st = this->arena.create<Station>(i, station_name);
+        st->setPop(spec.popularity[i]);
+        this->stations_by_name[station_name] = st;
+        this->stations.push_back(st);
     }
 
-    ifstream ifs(argv[1], std::ios_base::in);
-    if (!ifs.is_open()) {
-        cerr << "Failed to open " << argv[1] << '\n';
-        exit(2);
+    // Construct links from the nonzero cells of the adjacency mat
+    for (const EdgeSpec& e: spec.edges) {
+        Station *st_src = this->stations[e.src];
+        Station *st_dst = this->stations[e.dst];
+        Link *link = this->arena.create<Link>(this->links.size(), st_src, st_dst, e.distance);
+        this->links.emplace_back(link);
+        this->platforms.emplace_back(st_src->addLinkTowards(st_dst, link, this->arena));
     }
 
-    // Read S
-    size_t S;
-    ifs >> S;
+    // Station names of different lines
+    this->lines.resize(spec.lines.size());
+    for (unsigned l = 0; l < spec.lines.size(); ++l) {
+        this->lines[l].label = spec.line_labels[l];
+        for (const string& name: spec.lines[l]) {
+            this->lines[l].stations.push_back(this->stations_by_name[name]);
+        }
+    }
 
-    // Read station names.
-    string station_name;
-    vector<string> st_names;
-    st_names.reserve(S);
-    unordered_map<string, Station*> stations;
+    // managers point into the table, so it must not grow after this
+    for (Line& line: this->lines) {
+        line.manager = this->arena.create<LineStationsManager>(&line.stations);
+    }
 
-    for (size_t i = 0; i < S; ++i) {
-        ifs >> station_name;
-        st_names.emplace_back(station_name);
+    this->print_order.resize(this->lines.size());
+    iota(this->print_order.begin(), this->print_order.end(), 0);
+    stable_sort(this->print_order.begin(), this->print_order.end(), [this](unsigned a, unsigned b) {
+        return this->lines[a].label < this->lines[b].label;
+    });
+}
 
-        auto *st = new Station(station_name);
-        stations[station_name] = st;
+// Runs one simulation with the chosen engine, printing the requested ticks to stdout.
+void runEngine(const string& engine, Network& network, size_t N, const vector<size_t>& num_trains, size_t num_lines,
+               int num_threads, int num_regions, const SoARunOptions& soa_opts, SimStats* stats,
+               RunProfile* profile, PassengerFlow* passengers) {
+    DigestRecorder* digest = soa_opts.digest;
+    if (engine == "soa") {
+        simulateSoA(network, N, num_trains, num_lines, soa_opts);
+    } else if (engine == "event") {
+        simulateEvents(network, N, num_trains, num_lines, digest);
+    } else if (engine == "parallel") {
+        simulateParallel(network, N, num_trains, num_lines, num_threads, digest);
+    } else if (engine == "components") {
+        simulateComponents(network, N, num_trains, num_lines, digest);
+    } else if (engine == "regions") {
+        simulateRegions(network, N, num_trains, num_lines, num_regions, digest);
+    } else {
+        simulate(network, N, num_trains, num_lines, stats, profile, digest, passengers);
     }
+}
 
-    // Read P popularity
-    size_t p;
-    for (size_t i = 0; i < S; ++i) {
-        ifs >> p;
-        stations[st_names[i]]->setPop(p);
+int main(int argc, char const* argv[]) {
+
+    if (argc < 2) {
+        cerr << argv[0] << " <input_file> [--engine=tick|soa|event|parallel|components|regions] [--threads=N]"
+             << " [--regions=N]"
+             << " [--fast-forward[=K]] [--checkpoint=FILE [--save-at=T] [--save-every=K]] [--resume=FILE]"
+             << " [--batch=JOBS_FILE [--batch-out=DIR]] [--ensemble=JOBS_FILE [--lanes=K] [--batch-out=DIR]]"
+             << " [--stats=FILE] [--profile=FILE]"
+             << " [--digest=FILE] [--digest-compare=FILE] [--digest-every=K]"
+             << " [--passengers=FILE [--demand=X] [--train-capacity=N] [--board-rate=N]]"
+             << " [--record-base=DIR [--snapshot-every=K]] [--what-if=DIR] [--telemetry=FILE [--telemetry-every=K]]"
+             << " [--delta-trace=FILE]\n"
+             << "       " << argv[0] << " --bench [--engine=...] [--threads=N] [--regions=N] [--fast-forward[=K]]"
+             << " [--bench-stations=S1,S2,...] [--bench-trains=T1,T2,...] [--bench-lines=L] [--bench-ticks=N]"
+             << " [--bench-seed=SEED]\n";
+        exit(1);
     }
 
-    // Construct links from adjacency mat
-    vector<Link*> links;
-    size_t distance;
-    for (size_t src{}; src < S; ++src) {
-        for (size_t dst{}; dst < S; ++dst) {
-            ifs >> distance;
-            if (distance > 0) {
-                Station *st_src = stations[st_names[src]];
-                Station *st_dst = stations[st_names[dst]];
-                Link *link = new Link(st_src, st_dst, distance);
-                links.emplace_back(link);       // TODO: emplace_back和push_back有什么区别？
-                st_src->addLinkTowards(st_dst, link);
+    string engine = "tick";
+    int num_threads = omp_get_max_threads();
+    int num_regions = 2;
+    SoARunOptions soa_opts;
+    string batch_path, batch_out = ".";
+    bool ensemble = false;
+    unsigned lanes = 8;
+    string stats_path, profile_path;
+    DigestOptions digest_opts;
+    string passengers_path;
+    PassengerParams passenger_params;
+    bool passenger_options = false;
+    string base_dir, what_if_dir;
+    size_t snapshot_every = 0;
+    string telemetry_path;
+    uint64_t telemetry_every = 0;
+    string delta_path;
+    bool bench = strcmp(argv[1], "--bench") == 0;
+    BenchOptions bench_opts;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            engine = arg.substr(strlen("--engine="));
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            num_threads = max(1, atoi(arg.c_str() + strlen("--threads=")));
+        } else if (arg.rfind("--regions=", 0) == 0) {
+            num_regions = max(1, atoi(arg.c_str() + strlen("--regions=")));
+        } else if (arg == "--fast-forward") {
+            soa_opts.ff_interval = 64;
+        } else if (arg.rfind("--fast-forward=", 0) == 0) {
+            soa_opts.ff_interval = max(1L, atol(arg.c_str() + strlen("--fast-forward=")));
+        } else if (arg.rfind("--checkpoint=", 0) == 0) {
+            soa_opts.checkpoint_path = arg.substr(strlen("--checkpoint="));
+        } else if (arg.rfind("--save-at=", 0) == 0) {
+            soa_opts.save_at = strtoull(arg.c_str() + strlen("--save-at="), nullptr, 10);
+        } else if (arg.rfind("--save-every=", 0) == 0) {
+            soa_opts.save_every = strtoull(arg.c_str() + strlen("--save-every="), nullptr, 10);
+        } else if (arg.rfind("--resume=", 0) == 0) {
+            soa_opts.resume_path = arg.substr(strlen("--resume="));
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            batch_path = arg.substr(strlen("--batch="));
+        } else if (arg.rfind("--ensemble=", 0) == 0) {
+            batch_path = arg.substr(strlen("--ensemble="));
+            ensemble = true;
+        } else if (arg.rfind("--lanes=", 0) == 0) {
+            lanes = max(1, atoi(arg.c_str() + strlen("--lanes=")));
+        } else if (arg.rfind("--batch-out=", 0) == 0) {
+            batch_out = arg.substr(strlen("--batch-out="));
+        } else if (arg.rfind("--stats=", 0) == 0) {
+            stats_path = arg.substr(strlen("--stats="));
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            profile_path = arg.substr(strlen("--profile="));
+        } else if (arg.rfind("--digest=", 0) == 0) {
+            digest_opts.out_path = arg.substr(strlen("--digest="));
+        } else if (arg.rfind("--digest-compare=", 0) == 0) {
+            digest_opts.compare_path = arg.substr(strlen("--digest-compare="));
+        } else if (arg.rfind("--digest-every=", 0) == 0) {
+            digest_opts.every = max(1ULL, strtoull(arg.c_str() + strlen("--digest-every="), nullptr, 10));
+        } else if (arg.rfind("--passengers=", 0) == 0) {
+            passengers_path = arg.substr(strlen("--passengers="));
+        } else if (arg.rfind("--demand=", 0) == 0) {
+            passenger_params.demand = max(0.0, atof(arg.c_str() + strlen("--demand=")));
+            passenger_options = true;
+        } else if (arg.rfind("--train-capacity=", 0) == 0) {
+            passenger_params.capacity = max(0.0, atof(arg.c_str() + strlen("--train-capacity=")));
+            passenger_options = true;
+        } else if (arg.rfind("--board-rate=", 0) == 0) {
+            passenger_params.board_rate = max(0.0, atof(arg.c_str() + strlen("--board-rate=")));
+            passenger_options = true;
+        } else if (arg.rfind("--record-base=", 0) == 0) {
+            base_dir = arg.substr(strlen("--record-base="));
+        } else if (arg.rfind("--snapshot-every=", 0) == 0) {
+            snapshot_every = max(1ULL, strtoull(arg.c_str() + strlen("--snapshot-every="), nullptr, 10));
+        } else if (arg.rfind("--what-if=", 0) == 0) {
+            what_if_dir = arg.substr(strlen("--what-if="));
+        } else if (arg.rfind("--telemetry=", 0) == 0) {
+            telemetry_path = arg.substr(strlen("--telemetry="));
+        } else if (arg.rfind("--delta-trace=", 0) == 0) {
+            delta_path = arg.substr(strlen("--delta-trace="));
+        } else if (arg.rfind("--telemetry-every=", 0) == 0) {
+            telemetry_every = max(1ULL, strtoull(arg.c_str() + strlen("--telemetry-every="), nullptr, 10));
+        } else if (bench && arg.rfind("--bench-stations=", 0) == 0) {
+            if (!parseSizeList(arg.c_str() + strlen("--bench-stations="), bench_opts.stations)) {
+                cerr << "Bad option " << arg << '\n';
+                exit(1);
             }
+        } else if (bench && arg.rfind("--bench-trains=", 0) == 0) {
+            if (!parseSizeList(arg.c_str() + strlen("--bench-trains="), bench_opts.trains)) {
+                cerr << "Bad option " << arg << '\n';
+                exit(1);
+            }
+        } else if (bench && arg.rfind("--bench-lines=", 0) == 0) {
+            bench_opts.network_lines = max(1ULL, strtoull(arg.c_str() + strlen("--bench-lines="), nullptr, 10));
+        } else if (bench && arg.rfind("--bench-ticks=", 0) == 0) {
+            bench_opts.ticks = strtoull(arg.c_str() + strlen("--bench-ticks="), nullptr, 10);
+        } else if (bench && arg.rfind("--bench-seed=", 0) == 0) {
+            bench_opts.seed = strtoull(arg.c_str() + strlen("--bench-seed="), nullptr, 10);
+        } else {
+            cerr << "Unknown option " << arg << '\n';
+            exit(1);
         }
     }
+    if (engine != "tick" && engine != "soa" && engine != "event" && engine != "parallel"
+        && engine != "components" && engine != "regions") {
+        cerr << "Unknown engine " << engine << '\n';
+        exit(1);
+    }
+    bool saving = soa_opts.save_at != SIZE_MAX || soa_opts.save_every > 0;
+    if ((soa_opts.ff_interval > 0 || saving || !soa_opts.resume_path.empty()) && engine != "soa") {
+        cerr << "--fast-forward, --save-at, --save-every and --resume need --engine=soa\n";
+        exit(1);
+    }
+    if (saving && soa_opts.checkpoint_path.empty()) {
+        cerr << "--save-at and --save-every need --checkpoint=FILE\n";
+        exit(1);
+    }
+    if (!batch_path.empty() && (soa_opts.ff_interval > 0 || saving || !soa_opts.resume_path.empty())) {
+        cerr << "--batch runs plain soa jobs, without --fast-forward or checkpoints\n";
+        exit(1);
+    }
+#ifndef MRT_STATS
+    if (!stats_path.empty()) {
+        cerr << "--stats needs a build with -DMRT_STATS\n";
+        exit(1);
+    }
+#endif
+    if (!stats_path.empty() && (engine != "tick" || !batch_path.empty())) {
+        cerr << "--stats is only collected by --engine=tick\n";
+        exit(1);
+    }
+    if (!profile_path.empty() && ((engine != "tick" && engine != "soa") || !batch_path.empty())) {
+        cerr << "--profile is only collected by --engine=tick and --engine=soa\n";
+        exit(1);
+    }
+    if (passenger_options && passengers_path.empty()) {
+        cerr << "--demand, --train-capacity and --board-rate need --passengers=FILE\n";
+        exit(1);
+    }
+    if (!passengers_path.empty() && (engine != "tick" || !batch_path.empty() || bench)) {
+        cerr << "--passengers is only simulated by --engine=tick\n";
+        exit(1);
+    }
+    bool digesting = !digest_opts.out_path.empty() || !digest_opts.compare_path.empty();
+    if (digesting && (soa_opts.ff_interval > 0 || !soa_opts.resume_path.empty() || !batch_path.empty() || bench)) {
+        cerr << "--digest and --digest-compare need every tick simulated from 0, without --fast-forward,"
+             << " --resume, --batch or --bench\n";
+        exit(1);
+    }
+    if (snapshot_every > 0 && base_dir.empty()) {
+        cerr << "--snapshot-every needs --record-base=DIR\n";
+        exit(1);
+    }
+    bool what_if = !base_dir.empty() || !what_if_dir.empty();
+    if (what_if && (engine != "soa" || (!base_dir.empty() && !what_if_dir.empty()) || soa_opts.ff_interval > 0
+                    || saving || !soa_opts.resume_path.empty() || !batch_path.empty() || !profile_path.empty()
+                    || digesting || bench)) {
+        cerr << "--record-base and --what-if are plain --engine=soa runs, one at a time, without --fast-forward,"
+             << " checkpoints, --batch, --profile, --digest or --bench\n";
+        exit(1);
+    }
+    if (telemetry_every > 0 && telemetry_path.empty()) {
+        cerr << "--telemetry-every needs --telemetry=FILE\n";
+        exit(1);
+    }
+    if (!telemetry_path.empty() && (engine != "soa" || !batch_path.empty() || what_if || bench)) {
+        cerr << "--telemetry is only published by single --engine=soa runs\n";
+        exit(1);
+    }
+    if (!delta_path.empty() && (engine != "soa" || !batch_path.empty() || what_if || bench)) {
+        cerr << "--delta-trace is only written by single --engine=soa runs\n";
+        exit(1);
+    }
 
-    ifs.ignore();
+    if (bench) {
+        if (saving || !soa_opts.resume_path.empty() || !batch_path.empty() || !stats_path.empty()
+            || !profile_path.empty()) {
+            cerr << "--bench only takes --engine, --threads, --regions, --fast-forward and --bench-* options\n";
+            exit(1);
+        }
+        runBenchmark(bench_opts, [&](Network& network, const NetworkSpec& spec) {
+            runEngine(engine, network, spec.ticks, spec.num_trains, spec.num_lines, num_threads, num_regions,
+                      soa_opts, nullptr, nullptr, nullptr);
+        });
+        return 0;
+    }
 
-    // Read station names of different lines
+    RunProfile profile;
+    RunProfile *run_profile = profile_path.empty() ? nullptr : &profile;
+    soa_opts.profile = run_profile;
+    PhaseClock setup_clock(run_profile);
 
-    string stations_buf;
-    getline(ifs, stations_buf);
-    stringstream ss_green(stations_buf);
-    string green_station_name;
-    while (ss_green >> green_station_name) {
-        green_line.push_back(stations[green_station_name]);
+    long long parse_before, parse_after;
+    parse_before = wall_clock_time();
+    NetworkSpec spec;
+    if (!loadNetworkSpec(argv[1], spec)) {
+        exit(2);
+    }
+    parse_after = wall_clock_time();
+    fprintf(stderr, "%f seconds parsing input\n", ((float)(parse_after - parse_before)) / 1000000000);
+    setup_clock.lap(PHASE_PARSE);
+
+    Network network;
+    network.build(spec);
+    setup_clock.lap(PHASE_BUILD);
+
+    if (ensemble) {
+        // like --batch, the jobs replace the N, train counts and line count of the input file
+        vector<EnsembleJob> jobs;
+        if (!loadEnsembleJobs(batch_path, network, jobs)) {
+            exit(2);
+        }
+        long long before = wall_clock_time();
+        runEnsemble(network, jobs, batch_out, lanes, num_threads);
+        long long after = wall_clock_time();
+        bool all_ok = true;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            const EnsembleJob &job = jobs[i];
+            if (!job.ok) {
+                if (job.write_error != 0) {
+                    cerr << "Failed to write " << batch_out << "/job" << i << ".out: " << strerror(job.write_error) << '\n';
+                } else {
+                    cerr << "Failed to open " << batch_out << "/job" << i << ".out\n";
+                }
+                all_ok = false;
+                continue;
+            }
+            printf("job %zu: N=%zu", i, job.ticks);
+            for (unsigned l = 0; l < network.numLines(); ++l) {
+                printf(" %s=%zu", network.lines[l].label.c_str(), job.num_trains[l]);
+            }
+            printf(" lines=%zu changes=%zu digest=%016llx %f seconds\n", job.num_lines,
+                   job.popularity.size() + job.distance.size(), (unsigned long long)job.digest, job.seconds);
+        }
+        printf("%f seconds\n", ((float)(after - before)) / 1000000000);
+        return all_ok ? 0 : 2;
     }
 
-    getline(ifs, stations_buf);
-    stringstream ss_yellow(stations_buf);
-    string yellow_station_name;
-    while (ss_yellow >> yellow_station_name) {
-        yellow_line.push_back(stations[yellow_station_name]);
+    if (!batch_path.empty()) {
+        // the N, train counts and line count of the input file are replaced by the jobs
+        vector<BatchJob> jobs;
+        if (!loadBatchJobs(batch_path, network.numLines(), jobs)) {
+            exit(2);
+        }
+        long long before = wall_clock_time();
+        runBatch(network, jobs, batch_out, num_threads);
+        long long after = wall_clock_time();
+        bool all_ok = true;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            const BatchJob &job = jobs[i];
+            if (!job.ok) {
+                if (job.write_error != 0) {
+                    cerr << "Failed to write " << batch_out << "/job" << i << ".out: " << strerror(job.write_error) << '\n';
+                } else {
+                    cerr << "Failed to open " << batch_out << "/job" << i << ".out\n";
+                }
+                all_ok = false;
+                continue;
+            }
+            printf("job %zu: N=%zu", i, job.ticks);
+            for (unsigned l = 0; l < network.numLines(); ++l) {
+                printf(" %s=%zu", network.lines[l].label.c_str(), job.num_trains[l]);
+            }
+            printf(" lines=%zu %f seconds\n", job.num_lines, job.seconds);
+        }
+        printf("%f seconds\n", ((float)(after - before)) / 1000000000);
+        return all_ok ? 0 : 2;
     }
 
-    getline(ifs, stations_buf);
-    stringstream ss_blue(stations_buf);
-    string blue_station_name;
-    while (ss_blue >> blue_station_name) {
-        blue_line.push_back(stations[blue_station_name]);
+    // N time ticks
+    size_t N = spec.ticks;
+    if (soa_opts.save_at != SIZE_MAX && (soa_opts.save_at == 0 || soa_opts.save_at > N)) {
+        cerr << "--save-at=" << soa_opts.save_at << " is not in this run, which has " << N << " ticks\n";
+        exit(1);
     }
 
-    green_line_manager = new LineStationsManager(MRT_LINE_GREEN);
-    yellow_line_manager = new LineStationsManager(MRT_LINE_YELLOW);
-    blue_line_manager = new LineStationsManager(MRT_LINE_BLUE);
+    // number of trains per line
+    const vector<size_t>& num_trains = spec.num_trains;
 
-    // N time ticks
-    size_t N;
-    ifs >> N;
+    size_t num_lines = spec.num_lines;
 
-    // g,y,b number of trains per line
-    size_t g, y, b;
-    ifs >> g;
-    ifs >> y;
-    ifs >> b;
+#ifdef MRT_STATS
+    SimStats stats(network);
+    SimStats *run_stats = &stats;
+#else
+    SimStats *run_stats = nullptr;
+#endif
 
-    size_t num_lines;
-    ifs >> num_lines;
+    DigestRecorder digest(digest_opts);
+    if (!digest.ok()) {
+        exit(2);
+    }
+    if (digesting) soa_opts.digest = &digest;
+
+    if (!delta_path.empty()) {
+        soa_opts.delta_fd = open(delta_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (soa_opts.delta_fd < 0) {
+            perror(delta_path.c_str());
+            exit(2);
+        }
+    }
+
+    // last, a run that exits through exit() still removes the segment (see telemetry.h)
+    TelemetryPublisher *telemetry = nullptr;
+    if (!telemetry_path.empty()) {
+        telemetry = new TelemetryPublisher(telemetry_path, telemetry_every > 0 ? telemetry_every : 1024);
+        if (!telemetry->ok()) {
+            exit(2);
+        }
+        soa_opts.telemetry = telemetry;
+    }
+
+    PassengerFlow *passengers = nullptr;
+    if (!passengers_path.empty()) passengers = new PassengerFlow(network, passenger_params);
 
     long long before, after;
     before = wall_clock_time();
-    simulate(stations, N, g, y, b, num_lines);
+    if (!base_dir.empty()) {
+        if (!recordBaseRun(network, N, num_trains, num_lines, base_dir, snapshot_every > 0 ? snapshot_every : 4096)) {
+            exit(2);
+        }
+    } else if (!what_if_dir.empty()) {
+        if (!runWhatIf(network, N, num_trains, num_lines, what_if_dir)) {
+            exit(2);
+        }
+    } else {
+        runEngine(engine, network, N, num_trains, num_lines, num_threads, num_regions, soa_opts, run_stats,
+                  run_profile, passengers);
+    }
     after = wall_clock_time();
     printf("%f seconds\n", ((float)(after - before)) / 1000000000);
+    delete telemetry;
+    if (soa_opts.delta_fd >= 0) close(soa_opts.delta_fd);
+
+    if (digesting) {
+        digest.report();
+        if (digest.diverged()) return 3;
+    }
+
+#ifdef MRT_STATS
+    if (!stats_path.empty()) {
+        FILE *f = fopen(stats_path.c_str(), "w");
+        if (f == nullptr) {
+            cerr << "Failed to open " << stats_path << '\n';
+            exit(2);
+        }
+        stats.writeJson(f, N);
+        fclose(f);
+    }
+#endif
+
+    if (passengers != nullptr) {
+        FILE *f = fopen(passengers_path.c_str(), "w");
+        if (f == nullptr) {
+            cerr << "Failed to open " << passengers_path << '\n';
+            exit(2);
+        }
+        passengers->writeJson(f);
+        fclose(f);
+        delete passengers;
+    }
+
+    if (run_profile != nullptr) {
+        FILE *f = fopen(profile_path.c_str(), "w");
+        if (f == nullptr) {
+            cerr << "Failed to open " << profile_path << '\n';
+            exit(2);
+        }
+        profile.writeJson(f, engine);
+        fclose(f);
+    }
 
     return 0;
 }
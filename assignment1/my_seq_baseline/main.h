@@ -8,17 +8,12 @@
 #include <sstream>
 #include <vector>
 #include <unordered_map>
-#include <deque>
+#include "arena.h"
+#include "trace_formatter.h"
 using namespace std;
 
 using adjacency_matrix = vector<std::vector<size_t>>;
 
-enum MRT_LINE {
-    MRT_LINE_GREEN,
-    MRT_LINE_YELLOW,
-    MRT_LINE_BLUE
-};
-
 enum TRAIN_STATUS {
     /* static status begin */
     TRAIN_STATUS_INITIAL,
@@ -35,6 +30,8 @@ enum TRAIN_STATUS {
     /* transitioning status end */
 };
 
+const unsigned NUM_TRAIN_STATUSES = TRAIN_STATUS_TRANSITIONING + 1;
+
 enum DIRECTION {
     DIRECTION_FORWARD,
     DIRECTION_BACKWARD
@@ -46,23 +43,61 @@ class Platform;
 class Link;
 class LineStationsManager;
 class TimeCounter;
+class SimStats;
+class PassengerFlow;
+struct NetworkSpec;
+
+/* Precomputed step of a line: where a train at some position heading in some direction goes next.
+ * Built once per (position, direction) when the line is loaded, so the per-tick state machine
+ * never has to look anything up by station name. */
+struct RouteCursor {
+    Station *station;               // station the train is at
+    Station *next_station;          // nullptr past the end of the line
+    Link *target_link;              // station -> next_station
+    Platform *target_platform;      // platform of station heading to next_station
+    bool turnaround;                // next_station is the last one in this direction
+    unsigned arrival;               // index of the cursor to use once next_station is reached
+};
+
+class TimeCounter {
+public:
+    TimeCounter() {
+        this->time_to_count = 0;
+    }
+
+    void setCounter(unsigned count) {
+        this->time_to_count = count;
+    }
+
+    void count() {
+        this->time_to_count--;
+    }
+
+    bool finish() {
+        return this->time_to_count == 0;
+    }
+
+    unsigned remaining() {
+        return this->time_to_count;
+    }
 
-vector<Station*> green_line;
-vector<Station*> yellow_line;
-vector<Station*> blue_line;
-LineStationsManager *green_line_manager;
-LineStationsManager *yellow_line_manager;
-LineStationsManager *blue_line_manager;
+private:
+    unsigned time_to_count;
+};
 
 class Train {
 public:
-    Train(unsigned id, MRT_LINE line, Station *location);
+    Train(unsigned id, unsigned line, LineStationsManager *manager, unsigned line_pos);
 
     /* getters begin */
     unsigned getId() {
         return this->train_id;
     }
 
+    unsigned getLine() {
+        return this->line;
+    }
+
     TRAIN_STATUS currentStatus() {
         return this->status;
     }
@@ -87,21 +122,24 @@ public:
         return this->link_at;
     }
 
+    const RouteCursor *currentRoute() {
+        return this->route;
+    }
+
     LineStationsManager *lineStationsManager() {
-        switch (this->line) {
-            case MRT_LINE_GREEN: return green_line_manager;
-            case MRT_LINE_YELLOW: return yellow_line_manager;
-            case MRT_LINE_BLUE: return blue_line_manager;
-            default: return nullptr;
-        }
+        return this->manager;
     }
 
     TimeCounter *getLoadingCounter() {
-        return this->load_passengers_counter;
+        return &this->load_passengers_counter;
     }
 
     TimeCounter *getTravelingCounter() {
-        return this->travel_link_counter;
+        return &this->travel_link_counter;
+    }
+
+    Train *nextInQueue() {
+        return this->next_in_queue;
     }
     /* getters end */
 
@@ -127,15 +165,28 @@ public:
     void transition();
 
     void turnAround();
+
+    void advanceRoute();
     /* core functions end */
 
     /* print utils begin */
-    string currentInfo();
+    void writeInfo(TraceFormatter &out);
     /* print utils end */
 
+    void attachPassengers(PassengerFlow *p) {
+        this->passengers = p;
+    }
+
+#ifdef MRT_STATS
+    void attachStats(SimStats *s) {
+        this->stats = s;
+    }
+#endif
+
 private:
     unsigned train_id;
-    MRT_LINE line;
+    unsigned line;                      // index into Network::lines
+    LineStationsManager *manager;
 
     /* status begin */
     TRAIN_STATUS status;
@@ -143,23 +194,75 @@ private:
     Platform *platform_at;
     Link *link_at;          // used only when transitioning
     DIRECTION direction;
+    const RouteCursor *route;
     /* status end */
 
     /* counters begin */
-    TimeCounter *load_passengers_counter;
-    TimeCounter *travel_link_counter;
+    TimeCounter load_passengers_counter;
+    TimeCounter travel_link_counter;
     /* counters end */
+
+    Train *next_in_queue;   // next train in the same holding area
+    friend class TrainQueue;
+
+    PassengerFlow *passengers;  // nullptr unless passengers are simulated
+
+#ifdef MRT_STATS
+    SimStats *stats;
+    uint64_t queued_since;  // tick the train joined its current holding area
+#endif
+};
+
+// FIFO of trains linked through Train::next_in_queue, so queueing never allocates.
+class TrainQueue {
+public:
+    TrainQueue() {
+        this->head = nullptr;
+        this->tail = nullptr;
+    }
+
+    bool empty() {
+        return this->head == nullptr;
+    }
+
+    Train *front() {
+        return this->head;
+    }
+
+    void push_back(Train *train) {
+        train->next_in_queue = nullptr;
+        if (this->tail == nullptr) {
+            this->head = train;
+        } else {
+            this->tail->next_in_queue = train;
+        }
+        this->tail = train;
+    }
+
+    void pop_front() {
+        this->head = this->head->next_in_queue;
+        if (this->head == nullptr) this->tail = nullptr;
+    }
+
+private:
+    Train *head;
+    Train *tail;
 };
 
 class Platform {
 public:
     Platform() = default;
-    Platform(Station *st_belong, Station *st_head_to) {
+    Platform(unsigned id, Station *st_belong, Station *st_head_to) {
+        this->platform_id = id;
         this->st_belong = st_belong;
         this->st_head_to = st_head_to;
         occupied = false;
     }
 
+    unsigned getId() {
+        return this->platform_id;
+    }
+
     bool isOccupied() {
         return this->occupied;
     }
@@ -176,11 +279,16 @@ public:
         return st_head_to;
     }
 
+    Train *firstInHoldingArea() {
+        return this->holding_area.front();
+    }
+
 private:
+    unsigned platform_id;
     Station *st_belong;
     Station *st_head_to;
     bool occupied;
-    deque<Train*> holding_area;
+    TrainQueue holding_area;
 
     void addTrainToHoldingArea(Train *train) {
         this->holding_area.push_back(train);
@@ -191,11 +299,16 @@ private:
 class Station {
 public:
     Station() = default;
-    explicit Station(string& name) {
+    Station(unsigned id, string& name) {
+        this->station_id = id;
         this->name = name;
     }
 
-    string getName() {
+    unsigned getId() {
+        return this->station_id;
+    }
+
+    const string &getName() {
         return this->name;
     }
 
@@ -207,31 +320,27 @@ public:
         this->popularity = pop;
     }
 
-    void addLinkTowards(Station *dst, Link *link) {
-        this->links[dst->name] = link;
-        this->platforms[dst->name] = new Platform(this, dst);
-    }
+    Platform *addLinkTowards(Station *dst, Link *link, Arena &arena);
 
     /* core functions begin */
-    Platform *getTargetPlatform(Station *dst_station) {     // manage platforms and links
-        return this->platforms[dst_station->name];
-    }
+    // Only used while building routes, the tick loop reads the precomputed RouteCursor instead.
+    Platform *getTargetPlatform(Station *dst_station);     // manage platforms and links
 
-    Link *getTargetLink(Station *dst_station) {
-        return this->links[dst_station->name];
-    }
+    Link *getTargetLink(Station *dst_station);
     /* core functions end */
 
 private:
+    unsigned station_id;
     string name;
     unsigned popularity;
-    unordered_map<string, Platform*> platforms;         // dst station name -> platform
-    unordered_map<string, Link*> links;                 // dst station name -> link
+    vector<Platform*> platforms;         // platforms[i] heads to the dst station of links[i]
+    vector<Link*> links;                 // outgoing links, a station only has a handful
 };
 
 class Link {
 public:
-    Link(Station *from, Station *to, unsigned dist) {
+    Link(unsigned id, Station *from, Station *to, unsigned dist) {
+        this->link_id = id;
         this->st_from = from;
         this->st_to = to;
         this->distance = dist;
@@ -239,6 +348,10 @@ public:
         this->occupied = false;
     }
 
+    unsigned getId() {
+        return this->link_id;
+    }
+
     bool isOccupied() {
         return this->occupied;
     }
@@ -260,6 +373,7 @@ public:
     }
 
 private:
+    unsigned link_id;
     Station *st_from;
     Station *st_to;
     unsigned distance;
@@ -268,16 +382,35 @@ private:
 
 class LineStationsManager {
 public:
-     explicit LineStationsManager(MRT_LINE line) {
-        switch (line) {
-            case MRT_LINE_GREEN: this->line_stations = &green_line; break;
-            case MRT_LINE_YELLOW: this->line_stations = &yellow_line; break;
-            case MRT_LINE_BLUE: this->line_stations = &blue_line; break;
-            default: break;
-        }
-
-        for (unsigned i = 0; i < this->line_stations->size(); ++i) {
-            station_index[(*this->line_stations)[i]->getName()] = i;
+     explicit LineStationsManager(vector<Station*> *line_stations) {
+        this->line_stations = line_stations;
+
+        // routes[pos * 2 + direction] is the step taken from position pos in that direction
+        unsigned n = this->line_stations->size();
+        this->routes.resize(2 * n);
+        for (unsigned pos = 0; pos < n; ++pos) {
+            for (unsigned d = DIRECTION_FORWARD; d <= DIRECTION_BACKWARD; ++d) {
+                RouteCursor &r = this->routes[routeIndex(pos, (DIRECTION)d)];
+                r.station = (*this->line_stations)[pos];
+                bool at_end = d == DIRECTION_FORWARD ? pos + 1 >= n : pos == 0;
+                if (at_end) {
+                    r.next_station = nullptr;
+                    r.target_link = nullptr;
+                    r.target_platform = nullptr;
+                    r.turnaround = false;
+                    r.arrival = routeIndex(pos, (DIRECTION)d);
+                    continue;
+                }
+
+                unsigned next_pos = d == DIRECTION_FORWARD ? pos + 1 : pos - 1;
+                r.next_station = (*this->line_stations)[next_pos];
+                r.target_link = r.station->getTargetLink(r.next_station);
+                r.target_platform = r.station->getTargetPlatform(r.next_station);
+                r.turnaround = d == DIRECTION_FORWARD ? next_pos == n - 1 : next_pos == 0;
+                DIRECTION next_dir = r.turnaround ?
+                        (d == DIRECTION_FORWARD ? DIRECTION_BACKWARD : DIRECTION_FORWARD) : (DIRECTION)d;
+                r.arrival = routeIndex(next_pos, next_dir);
+            }
         }
     }
 
@@ -289,46 +422,52 @@ public:
         return this->line_stations->front() == st;
     }
 
-    Station *getNextStationOfDirection(Station *cur_station, DIRECTION direction) {
-        return direction == DIRECTION_FORWARD ?
-               getNextStationInLine(cur_station) : getPreviousStationInLine(cur_station);
+    unsigned numStations() {
+        return this->line_stations->size();
     }
 
-private:
-    Station *getNextStationInLine(Station *cur_station) {
-        unsigned index = station_index[cur_station->getName()];
-        return (*line_stations)[index + 1];
+    static unsigned routeIndex(unsigned pos, DIRECTION direction) {
+        return pos * 2 + direction;
     }
 
-    Station *getPreviousStationInLine(Station *cur_station) {
-        unsigned index = station_index[cur_station->getName()];
-        return (*line_stations)[index - 1];
+    const RouteCursor *routeAt(unsigned index) {
+        return &this->routes[index];
     }
 
+private:
     vector<Station*>* line_stations;
-    unordered_map<string, unsigned> station_index;
+    vector<RouteCursor> routes;
 };
 
-class TimeCounter {
-public:
-    TimeCounter() {
-        this->time_to_count = 0;
-    }
+/* One row of the line table. Trains of a line print as <label><id>-..., and lines are indexed in the
+ * order the input declares them, which is also the order trains are spawned in. */
+struct Line {
+    string label;
+    vector<Station*> stations;
+    LineStationsManager *manager;
+};
 
-    void setCounter(unsigned count) {
-        this->time_to_count = count;
-    }
+/* The loaded network: owns every station, link, platform and line manager. Nothing about the network
+ * is process-wide, so any number of networks and simulations can live in one address space. The
+ * Train* engine mutates the platform and link flags; the array engines only read it. */
+struct Network {
+    Arena arena;
+    vector<Station*> stations;                  // by station id
+    vector<Link*> links;                        // by link id
+    vector<Platform*> platforms;                // by platform id, a platform shares its id with its link
+    vector<Line> lines;                         // by line index
+    vector<unsigned> print_order;               // line indices sorted by label
+    unordered_map<string, Station*> stations_by_name;
 
-    void count() {
-        this->time_to_count--;
+    unsigned numLines() const {
+        return this->lines.size();
     }
 
-    bool finish() {
-        return this->time_to_count == 0;
-    }
+    Network() = default;
+    Network(const Network &) = delete;
+    Network &operator=(const Network &) = delete;
 
-private:
-    unsigned time_to_count;
+    void build(const NetworkSpec &spec);
 };
 
 #endif //CS3210_ASSIGNMENT1_MAIN_H
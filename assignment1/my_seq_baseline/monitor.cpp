@@ -0,0 +1,70 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -o monitor monitor.cpp
+ * Run: ./monitor <telemetry_file> [--interval=MS] [--once]
+ * Follows a ./main --engine=soa --telemetry=FILE run through its shared memory, printing a line per
+ * new sample until the run ends (or one line with --once). Only reads; the run never waits for it.
+ */
+#include "telemetry.h"
+#include <csignal>
+#include <thread>
+
+static void printSample(const TelemetrySample &s) {
+    printf("%6.2f%% %zu/%zu ticks  %.0f ticks/s  %zu trains  %zu queueing  %zu waiting for link"
+           "  longest queue %zu  flush %.3f ms",
+           s.ticks > 0 ? 100.0 * s.ticks_done / s.ticks : 100.0, (size_t)s.ticks_done, (size_t)s.ticks,
+           s.ticks_per_second, (size_t)s.trains, (size_t)s.status[TRAIN_STATUS_QUEUEING_FOR_PLATFORM],
+           (size_t)s.status[TRAIN_STATUS_WAITING_FOR_LINK], (size_t)s.longest_queue, s.flush_ns / 1e6);
+    for (unsigned p = 0; p < NUM_PHASES; ++p) {
+        if (s.phase_ns[p] > 0) printf("  %s %.3f s", PHASE_NAMES[p], s.phase_ns[p] / 1e9);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) {
+        cerr << argv[0] << " <telemetry_file> [--interval=MS] [--once]\n";
+        exit(1);
+    }
+    unsigned interval_ms = 500;
+    bool once = false;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--interval=", 0) == 0) {
+            interval_ms = max(1UL, strtoul(arg.c_str() + strlen("--interval="), nullptr, 10));
+        } else if (arg == "--once") {
+            once = true;
+        } else {
+            cerr << "Bad option " << arg << '\n';
+            exit(1);
+        }
+    }
+
+    int shmid;
+    const TelemetryRing *ring = attachTelemetry(argv[1], false, shmid);
+    if (ring == nullptr) {
+        exit(2);
+    }
+    if (ring->magic != TELEMETRY_MAGIC) {
+        cerr << argv[1] << " is not the telemetry of a run\n";
+        exit(2);
+    }
+
+    TelemetrySample sample;
+    uint64_t seen = 0, index;
+    while (true) {
+        bool finished = ring->finished.load(memory_order_acquire) != 0;
+        if (readLatestSample(ring, sample, index) && index + 1 > seen) {
+            seen = index + 1;
+            printSample(sample);
+            if (once) break;
+        }
+        if (finished || kill(ring->pid, 0) != 0) {
+            if (!finished) cerr << "Run " << ring->pid << " exited without finishing\n";
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(interval_ms));
+    }
+    shmdt((const void *)ring);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef CS3210_ASSIGNMENT1_NETGEN_H
+#define CS3210_ASSIGNMENT1_NETGEN_H
+
+#include "loader.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+/* Synthetic networks in the input format of loader.h.
+ *
+ * Every line is a simple path over randomly chosen stations, with a link both ways between
+ * consecutive stations. Lines meet at the stations they happen to share; on top of that,
+ * shared_segments times a two-station segment of one line is spliced into another line, so both
+ * lines run over the same platform and link, which is where trains of different lines queue
+ * behind each other.
+ *
+ * Popularity and distance are drawn as min + (max - min + 1) * u^shape for uniform u in [0, 1):
+ * shape 1 is uniform, larger shapes make small values more common. */
+
+struct GeneratorParams {
+    size_t num_stations = 100;
+    size_t num_network_lines = 3;
+    size_t min_line_length = 10;        // stations per line
+    size_t max_line_length = 30;
+    size_t shared_segments = 5;
+    uint32_t min_popularity = 1;
+    uint32_t max_popularity = 10;
+    double popularity_shape = 1.0;
+    uint32_t min_distance = 1;
+    uint32_t max_distance = 10;
+    double distance_shape = 1.0;
+    size_t trains_per_line = 10;
+    size_t ticks = 1000;
+    size_t num_lines = 10;              // printed ticks
+    uint64_t seed = 1;
+};
+
+class NetworkGenerator {
+public:
+    explicit NetworkGenerator(const GeneratorParams &params) : params(params), rng(params.seed) {
+    }
+
+    void generate(NetworkSpec &spec) {
+        const size_t S = max<size_t>(params.num_stations, 2);
+        spec = NetworkSpec();
+        lines.clear();
+        distances.clear();
+        for (size_t i = 0; i < S; ++i) {
+            spec.station_names.push_back("st" + to_string(i));
+            spec.popularity.push_back(draw(params.min_popularity, params.max_popularity, params.popularity_shape));
+        }
+
+        for (size_t l = 0; l < params.num_network_lines; ++l) {
+            lines.push_back(randomPath(S));
+            for (size_t i = 0; i + 1 < lines.back().size(); ++i) connect(lines.back()[i], lines.back()[i + 1]);
+        }
+        for (size_t k = 0; k < params.shared_segments && lines.size() >= 2; ++k) spliceSharedSegment();
+
+        for (const auto &entry: distances) {
+            spec.edges.push_back({(uint32_t)(entry.first >> 32), (uint32_t)entry.first, entry.second});
+        }
+        sort(spec.edges.begin(), spec.edges.end(), [](const EdgeSpec &a, const EdgeSpec &b) {
+            return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+        });
+
+        for (size_t l = 0; l < lines.size(); ++l) {
+            spec.line_labels.push_back(defaultLineLabel(l));
+            spec.lines.emplace_back();
+            for (uint32_t st: lines[l]) spec.lines.back().push_back(spec.station_names[st]);
+        }
+        spec.ticks = params.ticks;
+        spec.num_trains.assign(lines.size(), params.trains_per_line);
+        spec.num_lines = params.num_lines;
+    }
+
+private:
+    const GeneratorParams &params;
+    mt19937_64 rng;
+    vector<vector<uint32_t>> lines;
+    unordered_map<uint64_t, uint32_t> distances;    // (src << 32 | dst) -> distance
+
+    uint32_t draw(uint32_t lo, uint32_t hi, double shape) {
+        if (hi <= lo) return lo;
+        double u = uniform_real_distribution<double>(0.0, 1.0)(rng);
+        return lo + min<uint32_t>(hi - lo, (uint32_t)((hi - lo + 1) * pow(u, shape)));
+    }
+
+    size_t pick(size_t n) {
+        return uniform_int_distribution<size_t>(0, n - 1)(rng);
+    }
+
+    vector<uint32_t> randomPath(size_t S) {
+        size_t lo = min(max<size_t>(params.min_line_length, 2), S);
+        size_t hi = min(max(params.max_line_length, lo), S);
+        size_t len = lo + pick(hi - lo + 1);
+        vector<uint32_t> path;
+        unordered_set<uint32_t> used;
+        while (path.size() < len) {
+            uint32_t st = pick(S);
+            if (used.insert(st).second) path.push_back(st);
+        }
+        return path;
+    }
+
+    void connect(uint32_t a, uint32_t b) {
+        uint64_t ab = (uint64_t)a << 32 | b, ba = (uint64_t)b << 32 | a;
+        if (distances.count(ab)) return;
+        uint32_t d = draw(max<uint32_t>(params.min_distance, 1), max(params.max_distance, 1u), params.distance_shape);
+        distances[ab] = d;
+        distances[ba] = d;
+    }
+
+    // copies two consecutive stations of one line into another line that visits neither of them
+    void spliceSharedSegment() {
+        for (int attempt = 0; attempt < 32; ++attempt) {
+            size_t from = pick(lines.size()), to = pick(lines.size());
+            if (from == to || lines[from].size() < 2) continue;
+            size_t i = pick(lines[from].size() - 1);
+            uint32_t u = lines[from][i], v = lines[from][i + 1];
+            vector<uint32_t> &line = lines[to];
+            if (find(line.begin(), line.end(), u) != line.end() || find(line.begin(), line.end(), v) != line.end()) {
+                continue;
+            }
+            size_t at = pick(line.size() + 1);
+            line.insert(line.begin() + at, {u, v});
+            if (at > 0) connect(line[at - 1], u);
+            if (at + 2 < line.size()) connect(v, line[at + 2]);
+            return;
+        }
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_NETGEN_H
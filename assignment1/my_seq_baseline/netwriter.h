@@ -0,0 +1,164 @@
+#ifndef CS3210_ASSIGNMENT1_NETWRITER_H
+#define CS3210_ASSIGNMENT1_NETWRITER_H
+
+#include "loader.h"
+#include <cstdio>
+#include <unordered_map>
+
+/* Writers for the three input formats loader.h reads back; see there for the layouts. All of them
+ * expect spec.edges in row-major order, as the loader produces them. */
+
+enum NETWORK_FORMAT {
+    NETWORK_FORMAT_MATRIX,
+    NETWORK_FORMAT_SPARSE,
+    NETWORK_FORMAT_BINARY,
+};
+
+inline bool parseNetworkFormat(const string &name, NETWORK_FORMAT &format) {
+    if (name == "matrix") {
+        format = NETWORK_FORMAT_MATRIX;
+    } else if (name == "sparse") {
+        format = NETWORK_FORMAT_SPARSE;
+    } else if (name == "binary") {
+        format = NETWORK_FORMAT_BINARY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* text formats begin */
+inline void writeStationRows(FILE *f, const NetworkSpec &spec) {
+    const size_t S = spec.station_names.size();
+    for (size_t i = 0; i < S; ++i) fprintf(f, "%s%s", i == 0 ? "" : " ", spec.station_names[i].c_str());
+    fputc('\n', f);
+    for (size_t i = 0; i < S; ++i) fprintf(f, "%s%u", i == 0 ? "" : " ", spec.popularity[i]);
+    fputc('\n', f);
+}
+
+inline void writeLineRows(FILE *f, const NetworkSpec &spec) {
+    for (size_t l = 0; l < spec.lines.size(); ++l) {
+        if (spec.line_labels[l] != defaultLineLabel(l)) fprintf(f, "%s: ", spec.line_labels[l].c_str());
+        for (size_t i = 0; i < spec.lines[l].size(); ++i) {
+            fprintf(f, "%s%s", i == 0 ? "" : " ", spec.lines[l][i].c_str());
+        }
+        fputc('\n', f);
+    }
+    fprintf(f, "%zu\n", spec.ticks);
+    for (size_t l = 0; l < spec.num_trains.size(); ++l) fprintf(f, "%s%zu", l == 0 ? "" : " ", spec.num_trains[l]);
+    fprintf(f, "\n%zu\n", spec.num_lines);
+}
+
+// Writes spec in the input format; the adjacency matrix is written row by row from the edge list.
+inline bool writeNetworkSpec(FILE *f, const NetworkSpec &spec) {
+    const size_t S = spec.station_names.size();
+    fprintf(f, "%zu\n", S);
+    writeStationRows(f, spec);
+
+    string row;
+    size_t e = 0;
+    for (size_t r = 0; r < S; ++r) {
+        row.clear();
+        for (size_t c = 0; c < S; ++c) {
+            if (c > 0) row.push_back(' ');
+            if (e < spec.edges.size() && spec.edges[e].src == r && spec.edges[e].dst == c) {
+                row += to_string(spec.edges[e++].distance);
+            } else {
+                row.push_back('0');
+            }
+        }
+        row.push_back('\n');
+        fwrite(row.data(), 1, row.size(), f);
+    }
+
+    writeLineRows(f, spec);
+    return ferror(f) == 0;
+}
+
+inline bool writeSparseNetworkSpec(FILE *f, const NetworkSpec &spec) {
+    fprintf(f, "%s\n%zu %zu\n", SPARSE_KEYWORD, spec.station_names.size(), spec.edges.size());
+    writeStationRows(f, spec);
+    for (const EdgeSpec &e: spec.edges) fprintf(f, "%u %u %u\n", e.src, e.dst, e.distance);
+    writeLineRows(f, spec);
+    return ferror(f) == 0;
+}
+/* text formats end */
+
+template<typename T>
+bool writeVector(FILE *f, const vector<T> &a) {
+    return fwrite(a.data(), sizeof(T), a.size(), f) == a.size();
+}
+
+// Concatenates the strings, recording where each one ends.
+inline void makePool(const vector<string> &pieces, string &pool, vector<uint64_t> &ends) {
+    for (const string &piece: pieces) {
+        pool += piece;
+        ends.push_back(pool.size());
+    }
+}
+
+// Line stations are stored as station indices, so every name they use must be a station.
+inline bool writeBinaryNetworkSpec(FILE *f, const NetworkSpec &spec) {
+    const size_t S = spec.station_names.size(), L = spec.lines.size();
+    unordered_map<string, uint32_t> station_index;
+    for (size_t i = 0; i < S; ++i) station_index[spec.station_names[i]] = i;
+
+    string names, labels;
+    vector<uint64_t> name_end, label_end, line_end;
+    makePool(spec.station_names, names, name_end);
+    makePool(spec.line_labels, labels, label_end);
+
+    vector<uint64_t> row_begin(S + 1, 0);
+    vector<uint32_t> edge_dst, edge_distance;
+    for (const EdgeSpec &e: spec.edges) {
+        row_begin[e.src + 1]++;
+        edge_dst.push_back(e.dst);
+        edge_distance.push_back(e.distance);
+    }
+    for (size_t s = 0; s < S; ++s) row_begin[s + 1] += row_begin[s];
+
+    vector<uint32_t> line_station;
+    for (const vector<string> &line: spec.lines) {
+        for (const string &name: line) {
+            auto it = station_index.find(name);
+            if (it == station_index.end()) {
+                cerr << "Line station " << name << " is not a station\n";
+                return false;
+            }
+            line_station.push_back(it->second);
+        }
+        line_end.push_back(line_station.size());
+    }
+    vector<uint64_t> num_trains(spec.num_trains.begin(), spec.num_trains.end());
+
+    NetworkFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, NETWORK_MAGIC, sizeof(NETWORK_MAGIC));
+    h.version = NETWORK_VERSION;
+    h.num_network_lines = L;
+    h.num_stations = S;
+    h.num_edges = spec.edges.size();
+    h.name_bytes = names.size();
+    h.label_bytes = labels.size();
+    h.line_stations = line_station.size();
+    h.ticks = spec.ticks;
+    h.num_lines = spec.num_lines;
+    return fwrite(&h, sizeof(h), 1, f) == 1 && writeVector(f, name_end)
+           && fwrite(names.data(), 1, names.size(), f) == names.size() && writeVector(f, spec.popularity)
+           && writeVector(f, row_begin) && writeVector(f, edge_dst) && writeVector(f, edge_distance)
+           && writeVector(f, label_end) && fwrite(labels.data(), 1, labels.size(), f) == labels.size()
+           && writeVector(f, line_end) && writeVector(f, line_station) && writeVector(f, num_trains);
+}
+
+inline bool writeNetwork(FILE *f, const NetworkSpec &spec, NETWORK_FORMAT format) {
+    switch (format) {
+        case NETWORK_FORMAT_SPARSE:
+            return writeSparseNetworkSpec(f, spec);
+        case NETWORK_FORMAT_BINARY:
+            return writeBinaryNetworkSpec(f, spec);
+        default:
+            return writeNetworkSpec(f, spec);
+    }
+}
+
+#endif //CS3210_ASSIGNMENT1_NETWRITER_H
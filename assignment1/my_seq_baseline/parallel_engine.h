@@ -0,0 +1,159 @@
+#ifndef CS3210_ASSIGNMENT1_PARALLEL_ENGINE_H
+#define CS3210_ASSIGNMENT1_PARALLEL_ENGINE_H
+
+#include "soa_engine.h"
+#include "digest.h"
+#include <omp.h>
+
+/* Multithreaded version of simulate() that prints exactly what the sequential one prints.
+ *
+ * Trains only interact through platform occupancy, holding areas and link occupancy, and the tick
+ * loop settles every conflict by visiting trains in id order. Each tick therefore runs in two phases:
+ *   - read phase (parallel, static chunks of trains): count down, apply the transitions that touch
+ *     nothing shared (opening doors, starting to load) and record what every other train intends to do;
+ *   - commit phase (one thread): apply the recorded intents in id order against the platform and link
+ *     flags, which replays the serial priority order whatever the thread count. */
+
+enum INTENT_KIND {
+    INTENT_REQUEST_LINK,        // loading finished or waiting for link, take the link if it is free
+    INTENT_DEPART,              // leave the platform and enter the link
+    INTENT_ARRIVE               // leave the link, enter or queue for the next platform
+};
+
+struct TrainIntent {
+    uint32_t train;
+    uint32_t kind;
+    uint32_t link;              // link requested, entered or left
+    uint32_t platform;          // platform left or entered
+};
+
+const uint32_t PARALLEL_MIN_TRAINS = 4096;
+
+class ParallelEngine : public SoAEngine {
+public:
+    ParallelEngine(const SoATopology &topo, int num_threads) : SoAEngine(topo) {
+        this->num_threads = num_threads;
+        this->thread_intents.resize(num_threads);
+    }
+
+    void step() {
+        uint32_t n = numTrains();
+        for (vector<TrainIntent> &intents: thread_intents) intents.clear();
+        // small networks are not worth waking the team every tick
+#pragma omp parallel num_threads(num_threads) if(n >= PARALLEL_MIN_TRAINS)
+        {
+            int tid = omp_get_thread_num();
+            int nth = omp_get_num_threads();
+            uint32_t begin = (uint64_t)n * tid / nth;
+            uint32_t end = (uint64_t)n * (tid + 1) / nth;
+            countdownKernel(begin, end);
+            readPhase(begin, end, thread_intents[tid]);
+        }
+        // chunks are in id order, so visiting thread lists in order keeps the serial priority
+        for (vector<TrainIntent> &intents: thread_intents) {
+            for (const TrainIntent &it: intents) commit(it);
+        }
+    }
+
+private:
+    int num_threads;
+    vector<vector<TrainIntent>> thread_intents;
+
+    void readPhase(uint32_t begin, uint32_t end, vector<TrainIntent> &intents) {
+        for (uint32_t t = begin; t < end; ++t) {
+            if (!ready[t]) continue;
+            switch (status[t]) {
+                case TRAIN_STATUS_IN_PLATFORM: {
+                    status[t] = TRAIN_STATUS_OPENING_DOOR;
+                    break;
+                }
+                case TRAIN_STATUS_OPENING_DOOR: {
+                    status[t] = TRAIN_STATUS_LOADING_PASSENGERS;
+                    load_count[t]--;
+                    break;
+                }
+                case TRAIN_STATUS_LOADING_PASSENGERS:
+                case TRAIN_STATUS_WAITING_FOR_LINK: {
+                    uint32_t link = topo.route_link[route[t]];
+                    intents.push_back({t, INTENT_REQUEST_LINK, link, link});
+                    break;
+                }
+                case TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK: {
+                    uint32_t link = topo.route_link[route[t]];
+                    intents.push_back({t, INTENT_DEPART, link, link});
+                    break;
+                }
+                case TRAIN_STATUS_TRANSITIONING: {
+                    uint32_t arrival = topo.route_arrival[route[t]];
+                    intents.push_back({t, INTENT_ARRIVE, topo.route_link[route[t]], topo.route_link[arrival]});
+                    break;
+                }
+                default: break;     // queueing trains move when the platform is left
+            }
+        }
+    }
+
+    void commit(const TrainIntent &it) {
+        uint32_t t = it.train;
+        switch (it.kind) {
+            case INTENT_REQUEST_LINK: {
+                if (!link_occupied[it.link]) {
+                    waitForAnotherTickToLink(t, it.link);
+                } else {
+                    status[t] = TRAIN_STATUS_WAITING_FOR_LINK;
+                }
+                break;
+            }
+            case INTENT_DEPART: {
+                uint32_t promoted = leavePlatform(it.platform);
+                if (promoted != SOA_NONE && promoted > t) {
+                    // the serial loop reaches it later this tick and opens its door
+                    status[promoted] = TRAIN_STATUS_OPENING_DOOR;
+                }
+                status[t] = TRAIN_STATUS_TRANSITIONING;
+                link_occupied[it.link] = 1;
+                travel_count[t]--;
+                break;
+            }
+            case INTENT_ARRIVE: {
+                link_occupied[it.link] = 0;
+                route[t] = topo.route_arrival[route[t]];
+                if (platform_occupied[it.platform]) {
+                    enterPlatformQueue(t, it.platform);
+                } else {
+                    enterPlatform(t, it.platform);
+                    status[t] = TRAIN_STATUS_OPENING_DOOR;
+                }
+                break;
+            }
+            default: break;
+        }
+    }
+};
+
+void simulateParallel(const Network &network,
+                      size_t ticks,
+                      const vector<size_t> &wanted,
+                      size_t num_lines,
+                      int num_threads,
+                      DigestRecorder *digest) {
+    SoATopology topo(network);
+    ParallelEngine engine(topo, num_threads);
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, STDOUT_FILENO);
+
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        engine.spawnTick(wanted);
+        engine.step();
+        if (tick >= ticks - num_lines) {    // print info
+            engine.writeTick(tick, out);
+        }
+        if (digest != nullptr && digest->wants(tick) && !digest->record(tick, engine.canonicalDigest())) {
+            break;
+        }
+    }
+    flushOrExit(out);
+}
+
+#endif //CS3210_ASSIGNMENT1_PARALLEL_ENGINE_H
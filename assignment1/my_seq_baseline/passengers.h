@@ -0,0 +1,170 @@
+#ifndef CS3210_ASSIGNMENT1_PASSENGERS_H
+#define CS3210_ASSIGNMENT1_PASSENGERS_H
+
+#include "soa_engine.h"
+#include "stats.h"
+#include <cstdio>
+
+/* Aggregated passenger flow of a simulate() run, written with --passengers=FILE.
+ *
+ * Passengers are fluid counts, never objects: people waiting per route (a line, a position and a
+ * direction, so everyone waiting there wants the same train) and people on board per train. Each
+ * station produces demand * popularity passengers per tick, whose destinations are drawn in
+ * proportion to popularity over the stations reachable without changing trains; a route gets the
+ * share of the stations ahead of it. For the same reason, of the passengers on a train a fraction
+ * popularity(s) / popularity(stations still ahead) alights at s, whatever station they boarded at.
+ *
+ * Trains board up to board_rate passengers per loading tick (the dwell time is the popularity, as
+ * before) until they reach capacity, and alight on entering a platform. None of it changes where
+ * trains go, so the printed output stays the same. */
+
+struct PassengerParams {
+    double demand = 1.0;                // passengers per tick per unit of station popularity
+    double capacity = 1000.0;           // per train
+    double board_rate = 50.0;           // passengers boarding per loading tick
+};
+
+class PassengerFlow {
+public:
+    PassengerFlow(const Network &network, const PassengerParams &params) : network(network), topo(network) {
+        this->params = params;
+        size_t R = topo.route_station.size();
+        this->ahead.assign(R, 0.0);
+        this->waiting.assign(R, 0.0);
+        this->generation.assign(R, 0.0);
+        this->boarded.assign(network.numLines(), 0.0);
+        this->alighted.assign(network.numLines(), 0.0);
+        this->passenger_distance.assign(network.numLines(), 0.0);
+        this->ticks = 0;
+
+        vector<double> station_weight(network.stations.size(), 0.0);
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            uint32_t base = topo.line_route_base[l], n = topo.line_num_stations[l];
+            vector<double> before(n + 1, 0.0);          // popularity of positions < i
+            for (uint32_t i = 0; i < n; ++i) {
+                before[i + 1] = before[i] + topo.station_popularity[topo.route_station[base + 2 * i]];
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                for (unsigned d = DIRECTION_FORWARD; d <= DIRECTION_BACKWARD; ++d) {
+                    uint32_t r = base + LineStationsManager::routeIndex(i, (DIRECTION)d);
+                    if (topo.route_link[r] == SOA_NONE) continue;       // past the end of the line
+                    this->ahead[r] = d == DIRECTION_FORWARD ? before[n] - before[i + 1] : before[i];
+                    station_weight[topo.route_station[r]] += this->ahead[r];
+                }
+            }
+        }
+        for (uint32_t r = 0; r < R; ++r) {
+            uint32_t st = topo.route_station[r];
+            if (station_weight[st] > 0) {
+                this->generation[r] = params.demand * topo.station_popularity[st] * this->ahead[r] / station_weight[st];
+            }
+        }
+    }
+
+    void addTrain(uint32_t train, uint32_t line) {
+        if (train >= this->on_board.size()) {
+            this->on_board.resize(train + 1, 0.0);
+            this->remaining.resize(train + 1, 0.0);
+            this->train_line.resize(train + 1, 0);
+        }
+        this->train_line[train] = line;
+    }
+
+    // new demand of one tick, on every route at once
+    void generate() {
+        double *w = this->waiting.data();
+        const double *g = this->generation.data();
+        size_t R = this->waiting.size();
+#pragma omp simd
+        for (size_t r = 0; r < R; ++r) w[r] += g[r];
+        this->ticks++;
+    }
+
+    /* train hooks begin */
+    void alight(uint32_t train, uint32_t station) {
+        double &on = this->on_board[train];
+        if (on <= 0) return;
+        double pop = topo.station_popularity[station];
+        double off = this->remaining[train] > pop ? on * pop / this->remaining[train] : on;
+        on -= off;
+        this->alighted[this->train_line[train]] += off;
+    }
+
+    // route is the index within the train's line
+    void board(uint32_t train, uint32_t route) {
+        uint32_t r = topo.line_route_base[this->train_line[train]] + route;
+        double &on = this->on_board[train];
+        double in = min(min(this->waiting[r], this->params.capacity - on), this->params.board_rate);
+        if (in > 0) {
+            on += in;
+            this->waiting[r] -= in;
+            this->boarded[this->train_line[train]] += in;
+        }
+        this->remaining[train] = this->ahead[r];
+    }
+
+    void departed(uint32_t train, uint32_t distance) {
+        this->passenger_distance[this->train_line[train]] += this->on_board[train] * distance;
+    }
+    /* train hooks end */
+
+    void writeJson(FILE *f) const {
+        double span = this->ticks > 0 ? (double)this->ticks : 1.0;
+        vector<double> line_on_board(topo.numLines(), 0.0), line_waiting(topo.numLines(), 0.0);
+        for (size_t t = 0; t < this->on_board.size(); ++t) line_on_board[this->train_line[t]] += this->on_board[t];
+        vector<double> station_waiting(network.stations.size(), 0.0), station_generated(network.stations.size(), 0.0);
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            uint32_t end = topo.line_route_base[l] + 2 * topo.line_num_stations[l];
+            for (uint32_t r = topo.line_route_base[l]; r < end; ++r) {
+                line_waiting[l] += this->waiting[r];
+                station_waiting[topo.route_station[r]] += this->waiting[r];
+                station_generated[topo.route_station[r]] += this->generation[r] * this->ticks;
+            }
+        }
+
+        fprintf(f, "{\n  \"ticks\": %llu,\n  \"demand\": %.6f,\n  \"capacity\": %.3f,\n  \"board_rate\": %.3f,\n"
+                   "  \"lines\": [", (unsigned long long)this->ticks, this->params.demand, this->params.capacity,
+                this->params.board_rate);
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            fprintf(f, "%s\n    {\"label\": ", l == 0 ? "" : ",");
+            writeJsonString(f, network.lines[l].label);
+            fprintf(f, ", \"boarded\": %.3f, \"alighted\": %.3f, \"alighted_per_tick\": %.6f,"
+                       " \"passenger_distance\": %.3f, \"on_board\": %.3f, \"waiting\": %.3f}",
+                    this->boarded[l], this->alighted[l], this->alighted[l] / span, this->passenger_distance[l],
+                    line_on_board[l], line_waiting[l]);
+        }
+        fprintf(f, "\n  ],\n  \"stations\": [");
+        for (size_t s = 0; s < network.stations.size(); ++s) {
+            fprintf(f, "%s\n    {\"name\": ", s == 0 ? "" : ",");
+            writeJsonString(f, network.stations[s]->getName());
+            fprintf(f, ", \"generated\": %.3f, \"waiting\": %.3f}", station_generated[s], station_waiting[s]);
+        }
+        fprintf(f, "\n  ]\n}\n");
+    }
+
+private:
+    const Network &network;
+    SoATopology topo;
+    PassengerParams params;
+    uint64_t ticks;
+
+    /* per route begin */
+    vector<double> ahead;               // popularity of the stations still ahead in this direction
+    vector<double> waiting;
+    vector<double> generation;          // new passengers per tick
+    /* per route end */
+
+    /* per train begin */
+    vector<double> on_board;
+    vector<double> remaining;           // `ahead` of the route the train last boarded on
+    vector<uint32_t> train_line;
+    /* per train end */
+
+    /* per line begin */
+    vector<double> boarded;
+    vector<double> alighted;
+    vector<double> passenger_distance;  // passengers times link distance
+    /* per line end */
+};
+
+#endif //CS3210_ASSIGNMENT1_PASSENGERS_H
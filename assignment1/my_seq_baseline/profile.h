@@ -0,0 +1,127 @@
+#ifndef CS3210_ASSIGNMENT1_PROFILE_H
+#define CS3210_ASSIGNMENT1_PROFILE_H
+
+#include "main.h"
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+/* Phase timing and train status histograms of one run, written with --profile=FILE.
+ *
+ * The tick loop laps a PhaseClock after each of its phases, so the phases add up to the loop's wall
+ * time; flushes happen inside formatting and are moved to their own phase from the formatter's count.
+ * Status histograms count, per tick, how many trains are in each status and bucket that number by
+ * powers of two (bucket 0 is zero trains, bucket k holds 2^(k-1) .. 2^k - 1 trains). */
+
+enum PHASE {
+    PHASE_PARSE,
+    PHASE_BUILD,
+    PHASE_SPAWN,
+    PHASE_UPDATE,
+    PHASE_FORMAT,
+    PHASE_FLUSH,
+    NUM_PHASES
+};
+
+const char *const PHASE_NAMES[NUM_PHASES] = {"parse", "build", "spawn", "update", "format", "flush"};
+
+const char *const TRAIN_STATUS_NAMES[NUM_TRAIN_STATUSES] = {
+    "initial", "in_platform", "queueing_for_platform", "opening_door", "loading_passengers",
+    "waiting_for_link", "waiting_for_another_tick", "transitioning"
+};
+
+#define PROFILE_BUCKETS 33
+
+inline uint64_t monotonicNanos() {
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000000000ull + tp.tv_nsec;
+}
+
+class RunProfile {
+public:
+    RunProfile() {
+        for (uint64_t &ns: this->phase_ns) ns = 0;
+        for (unsigned s = 0; s < NUM_TRAIN_STATUSES; ++s) {
+            this->status_max[s] = 0;
+            this->status_sum[s] = 0;
+            for (uint64_t &b: this->status_buckets[s]) b = 0;
+        }
+        this->ticks_sampled = 0;
+    }
+
+    void addPhase(PHASE phase, uint64_t ns) {
+        this->phase_ns[phase] += ns;
+    }
+
+    uint64_t phaseNanos(PHASE phase) const {
+        return this->phase_ns[phase];
+    }
+
+    // time already counted as formatting that was spent waiting for the trace writer
+    void moveToFlush(uint64_t ns) {
+        this->phase_ns[PHASE_FORMAT] -= min(ns, this->phase_ns[PHASE_FORMAT]);
+        this->phase_ns[PHASE_FLUSH] += ns;
+    }
+
+    void sampleTick(const size_t counts[NUM_TRAIN_STATUSES]) {
+        for (unsigned s = 0; s < NUM_TRAIN_STATUSES; ++s) {
+            size_t n = counts[s];
+            unsigned bucket = n == 0 ? 0 : 64 - __builtin_clzll(n);
+            this->status_buckets[s][min(bucket, PROFILE_BUCKETS - 1u)]++;
+            this->status_max[s] = max<uint64_t>(this->status_max[s], n);
+            this->status_sum[s] += n;
+        }
+        this->ticks_sampled++;
+    }
+
+    void writeJson(FILE *f, const string &engine) const {
+        fprintf(f, "{\n  \"engine\": \"%s\",\n  \"phases_seconds\": {", engine.c_str());
+        for (unsigned p = 0; p < NUM_PHASES; ++p) {
+            fprintf(f, "%s\"%s\": %.9f", p == 0 ? "" : ", ", PHASE_NAMES[p], this->phase_ns[p] / 1e9);
+        }
+        fprintf(f, "},\n  \"ticks_sampled\": %llu,\n  \"status_histograms\": {",
+                (unsigned long long)this->ticks_sampled);
+        for (unsigned s = 0; s < NUM_TRAIN_STATUSES; ++s) {
+            double mean = this->ticks_sampled > 0 ? (double)this->status_sum[s] / this->ticks_sampled : 0.0;
+            fprintf(f, "%s\n    \"%s\": {\"mean\": %.6f, \"max\": %llu, \"log2_buckets\": [", s == 0 ? "" : ",",
+                    TRAIN_STATUS_NAMES[s], mean, (unsigned long long)this->status_max[s]);
+            unsigned last = PROFILE_BUCKETS;         // trailing empty buckets are left out
+            while (last > 1 && this->status_buckets[s][last - 1] == 0) --last;
+            for (unsigned b = 0; b < last; ++b) {
+                fprintf(f, "%s%llu", b == 0 ? "" : ", ", (unsigned long long)this->status_buckets[s][b]);
+            }
+            fprintf(f, "]}");
+        }
+        fprintf(f, "\n  }\n}\n");
+    }
+
+private:
+    uint64_t phase_ns[NUM_PHASES];
+    uint64_t status_buckets[NUM_TRAIN_STATUSES][PROFILE_BUCKETS];
+    uint64_t status_max[NUM_TRAIN_STATUSES];
+    uint64_t status_sum[NUM_TRAIN_STATUSES];
+    uint64_t ticks_sampled;
+};
+
+// Charges the time since the previous lap to a phase. Does nothing without a profile.
+class PhaseClock {
+public:
+    explicit PhaseClock(RunProfile *profile) {
+        this->profile = profile;
+        this->last = profile != nullptr ? monotonicNanos() : 0;
+    }
+
+    void lap(PHASE phase) {
+        if (this->profile == nullptr) return;
+        uint64_t now = monotonicNanos();
+        this->profile->addPhase(phase, now - this->last);
+        this->last = now;
+    }
+
+private:
+    RunProfile *profile;
+    uint64_t last;
+};
+
+#endif //CS3210_ASSIGNMENT1_PROFILE_H
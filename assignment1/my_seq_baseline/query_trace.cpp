@@ -0,0 +1,120 @@
+/*
+ * Compile: g++ -O3 -std=c++17 -fopenmp -pthread -o query_trace query_trace.cpp
+ * Run: ./query_trace build <trace_file> <store_file> [--keyframe-every=C]
+ *      ./query_trace <store_file> at <train> <tick>
+ *      ./query_trace <store_file> link <src>-><dst> <from_tick> <to_tick>
+ *      ./query_trace <store_file> tick <tick>
+ * build turns a ./main --delta-trace=FILE trace into a store with a keyframe every C changes (by
+ * default 4096 or the number of trains, whichever is larger), see trace_store.h. The queries print
+ * where a train (e.g. g12) was at a tick, which trains were on a link during [from, to], or the line
+ * ./main printed for a tick. Quote the link in the shell, '>' redirects. The time a query took goes
+ * to stderr.
+ */
+#include "trace_store.h"
+#include "profile.h"
+
+static void usage(const char *self) {
+    cerr << self << " build <trace_file> <store_file> [--keyframe-every=C]\n"
+         << self << " <store_file> at <train> <tick>\n"
+         << self << " <store_file> link <src>-><dst> <from_tick> <to_tick>\n"
+         << self << " <store_file> tick <tick>\n";
+    exit(1);
+}
+
+static int build(int argc, char const* argv[]) {
+    if (argc < 4) usage(argv[0]);
+    uint64_t keyframe_changes = 0;
+    for (int i = 4; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--keyframe-every=", 0) == 0) {
+            keyframe_changes = max(1ULL, strtoull(arg.c_str() + strlen("--keyframe-every="), nullptr, 10));
+        } else {
+            cerr << "Bad option " << arg << '\n';
+            exit(1);
+        }
+    }
+    DeltaTraceReader trace;
+    if (!trace.open(argv[2])) {
+        exit(2);
+    }
+    if (keyframe_changes == 0) keyframe_changes = max<uint64_t>(4096, trace.header.num_trains);
+    if (!buildTraceStore(trace, argv[3], keyframe_changes)) {
+        exit(2);
+    }
+    return 0;
+}
+
+static uint64_t parseTick(const char *s) {
+    char *end;
+    uint64_t tick = strtoull(s, &end, 10);
+    if (*s == '\0' || *end != '\0') {
+        cerr << "Bad tick " << s << '\n';
+        exit(1);
+    }
+    return tick;
+}
+
+int main(int argc, char const* argv[]) {
+    if (argc < 2) usage(argv[0]);
+    if (strcmp(argv[1], "build") == 0) return build(argc, argv);
+    if (argc < 4) usage(argv[0]);
+
+    TraceStore store;
+    if (!store.open(argv[1])) {
+        exit(2);
+    }
+    const TraceStoreHeader &h = store.header;
+    string query = argv[2];
+    uint64_t before = monotonicNanos();
+    if (query == "at" && argc == 5) {
+        uint32_t train = store.findTrain(argv[3]);
+        if (train == DELTA_NOWHERE) {
+            cerr << "No train " << argv[3] << '\n';
+            exit(2);
+        }
+        uint64_t tick = parseTick(argv[4]);
+        uint32_t location = store.locationAt(train, tick);
+        if (tick < h.first_tick || tick >= h.end_tick) {
+            printf("tick %llu is not in the trace, which has ticks %llu to %llu\n", (unsigned long long)tick,
+                   (unsigned long long)h.first_tick, (unsigned long long)h.end_tick - 1);
+        } else if (location == DELTA_NOWHERE) {
+            printf("%s has not appeared by tick %llu\n", argv[3], (unsigned long long)tick);
+        } else {
+            printf("%s %s\n", store.trainLabel(train).c_str(), store.locationName(location).c_str());
+        }
+    } else if (query == "link" && argc == 6) {
+        uint32_t link = store.findLink(argv[3]);
+        if (link == DELTA_NOWHERE) {
+            cerr << "No link " << argv[3] << '\n';
+            exit(2);
+        }
+        uint64_t from = parseTick(argv[4]), to = parseTick(argv[5]);
+        if (from > to) {
+            cerr << "Bad tick range " << from << " to " << to << '\n';
+            exit(1);
+        }
+        vector<const StoreVisit *> found;
+        store.linkVisits(link, from, to, found);
+        for (const StoreVisit *v: found) {
+            printf("%s ticks %llu to %llu\n", store.trainLabel(v->train).c_str(), (unsigned long long)v->enter,
+                   (unsigned long long)v->leave - 1);
+        }
+    } else if (query == "tick" && argc == 4) {
+        uint64_t tick = parseTick(argv[3]);
+        vector<uint32_t> location, shown;
+        store.stateAt(tick, location);
+        for (uint32_t id = 0; id < location.size(); ++id) {
+            if (location[id] != DELTA_NOWHERE) shown.push_back(id);
+        }
+        stable_sort(shown.begin(), shown.end(), [&store](uint32_t a, uint32_t b) {
+            return store.trainRank(a) < store.trainRank(b);
+        });
+        string line = to_string(tick) + ":";
+        for (uint32_t id: shown) line += " " + store.trainName(id) + store.locationName(location[id]);
+        if (tick >= h.first_tick && tick < h.end_tick) puts(line.c_str());
+    } else {
+        usage(argv[0]);
+    }
+    fprintf(stderr, "%.1f us\n", (monotonicNanos() - before) / 1e3);
+    return 0;
+}
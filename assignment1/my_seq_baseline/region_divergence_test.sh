@@ -0,0 +1,29 @@
+#!/bin/bash
+#	Runs --engine=regions against a digest stream that diverges, many times over: every run has to
+#	stop with exit code 3 instead of hanging in the barrier.
+#
+#	USAGE:	./region_divergence_test.sh <main_binary> <input_file> [runs] [regions]
+
+MAIN=${1:?main binary}
+INPUT=${2:?input file}
+RUNS=${3:-200}
+REGIONS=${4:-8}
+TMP=$(mktemp -d)
+trap 'rm -rf $TMP' EXIT
+
+$MAIN $INPUT --engine=soa --digest=$TMP/ref > /dev/null 2>&1 || { echo "reference run failed"; exit 1; }
+failed=0
+for ((i = 0; i < RUNS; i++)); do
+	# make a different sampled tick diverge each time, the state column is the second one
+	lines=$(wc -l < $TMP/ref)
+	awk -v at=$((i % lines + 1)) 'NR == at { $2 = "0" } { print }' $TMP/ref > $TMP/bad
+	timeout 5 $MAIN $INPUT --engine=regions --regions=$REGIONS --digest-compare=$TMP/bad > /dev/null 2>&1
+	rc=$?
+	if [[ $rc -ne 3 ]]; then
+		echo "run $i (tick line $((i % lines + 1))): exit code $rc"
+		pkill -KILL -f -- "--digest-compare=$TMP/bad"     # regions left in the barrier
+		failed=$((failed + 1))
+	fi
+done
+echo "$failed of $RUNS runs failed"
+[[ $failed -eq 0 ]]
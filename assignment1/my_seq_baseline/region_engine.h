@@ -0,0 +1,410 @@
+#ifndef CS3210_ASSIGNMENT1_REGION_ENGINE_H
+#define CS3210_ASSIGNMENT1_REGION_ENGINE_H
+
+#include "soa_engine.h"
+#include "digest.h"
+#include <cerrno>
+#include <csignal>
+#include <semaphore.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Runs each region of the network in its own process.
+ *
+ * Stations are split into regions; a region owns the platforms of its stations and, since a platform
+ * shares its id with its link, the links leaving them. Every region process forked from the parent
+ * keeps a SoAEngine holding only the trains currently on its platforms or links, in id order.
+ * Platform and link conflicts are then always settled inside one region, except for a train at the
+ * end of a link into another region: the source region releases the link and the destination region
+ * enters the platform, both at the train's place in id order, so the serial priority is kept.
+ *
+ * Per tick, every region spawns its trains and writes the ones about to cross into its outbox, then
+ * waits on a barrier shared with the parent; after it, every region takes in the trains sent to it,
+ * steps, drops the trains that left and writes printed positions and digests to shared memory. One
+ * barrier per tick is enough because outboxes, positions and digests are double buffered by tick
+ * parity: a buffer is only written again two barriers later, when every reader is done with it. The
+ * parent prints tick T - 1 while the regions run tick T.
+ * Shared memory and process-shared semaphores are set up as in L1_code/semaph_shm.c. */
+
+// Reusable barrier for processes: the last one to arrive flips the sense and opens the gate of the
+// old sense, so a process already waiting for the next round cannot take a post meant for this one.
+struct ShmBarrier {
+    sem_t mutex;
+    sem_t gate[2];
+    uint32_t parties;
+    uint32_t count;
+    uint32_t sense;
+
+    void init(uint32_t parties) {
+        sem_init(&this->mutex, 1, 1);
+        sem_init(&this->gate[0], 1, 0);
+        sem_init(&this->gate[1], 1, 0);
+        this->parties = parties;
+        this->count = 0;
+        this->sense = 0;
+    }
+
+    void destroy() {
+        sem_destroy(&this->mutex);
+        sem_destroy(&this->gate[0]);
+        sem_destroy(&this->gate[1]);
+    }
+
+    void wait() {
+        semWait(&this->mutex);
+        uint32_t s = this->sense;
+        if (++this->count == this->parties) {
+            this->count = 0;
+            this->sense = !s;
+            sem_post(&this->mutex);
+            for (uint32_t i = 1; i < this->parties; ++i) sem_post(&this->gate[s]);
+        } else {
+            sem_post(&this->mutex);
+            semWait(&this->gate[s]);
+        }
+    }
+
+    static void semWait(sem_t *sem) {
+        while (sem_wait(sem) != 0 && errno == EINTR) {
+        }
+    }
+};
+
+// A train handed to another region, with the state it had on its link.
+struct RegionMigrant {
+    uint32_t dst_region;
+    uint32_t train_id;
+    uint32_t line;
+    uint32_t route;             // route of the link, the destination moves it on to the arrival
+    uint32_t station_at;
+    uint32_t load_count;
+};
+
+#define REGION_ON_LINK 0x80000000u      // printed position is a link, not a station
+
+// Stations in breadth-first order over the links, cut into regions of about the same number of
+// platforms. Neighbouring stations mostly end up together, which keeps crossings few.
+vector<uint32_t> partitionStations(const Network &network, uint32_t num_regions) {
+    size_t S = network.stations.size();
+    vector<vector<uint32_t>> adjacent(S);
+    vector<size_t> weight(S, 1);        // platforms of the station, every station weighs at least 1
+    for (Link *link: network.links) {
+        weight[link->getSrcStation()->getId()]++;
+        adjacent[link->getSrcStation()->getId()].push_back(link->getDstStation()->getId());
+        adjacent[link->getDstStation()->getId()].push_back(link->getSrcStation()->getId());
+    }
+    vector<uint32_t> order;
+    vector<uint8_t> seen(S, 0);
+    for (uint32_t root = 0; root < S; ++root) {
+        if (seen[root]) continue;
+        seen[root] = 1;
+        order.push_back(root);
+        for (size_t head = order.size() - 1; head < order.size(); ++head) {
+            for (uint32_t next: adjacent[order[head]]) {
+                if (!seen[next]) {
+                    seen[next] = 1;
+                    order.push_back(next);
+                }
+            }
+        }
+    }
+
+    size_t total = network.platforms.size() + S;
+    vector<uint32_t> station_region(S, 0);
+    size_t done = 0;
+    for (uint32_t st: order) {
+        station_region[st] = min<size_t>(done * num_regions / max<size_t>(total, 1), num_regions - 1);
+        done += weight[st];
+    }
+    return station_region;
+}
+
+class RegionEngine : public SoAEngine {
+public:
+    RegionEngine(const SoATopology &topo, const vector<uint32_t> &platform_region, uint32_t region)
+        : SoAEngine(topo), platform_region(platform_region) {
+        this->region = region;
+        for (uint32_t p = 0; p < platform_region.size(); ++p) {
+            if (platform_region[p] == region) owned_platforms.push_back(p);
+        }
+    }
+
+    // same spawning rule as SoAEngine::spawnTick(), trains starting in other regions only take an id
+    void spawnTick(const vector<size_t> &wanted) {
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            size_t cur = spawned[l];
+            unsigned num = cur + 2 <= wanted[l] ? 2 : (cur + 1 <= wanted[l] ? 1 : 0);
+            spawned[l] += num;
+            for (unsigned i = 0; i < num; ++i) {
+                bool at_terminal = i == 1;
+                if (platform_region[topo.route_link[topo.spawnRoute(l, at_terminal)]] == region) {
+                    spawnTrain(l, at_terminal);
+                    leaving.push_back(0);
+                } else {
+                    next_train_id++;
+                }
+            }
+        }
+    }
+
+    // Writes the trains that reach another region's platform this tick, returns how many.
+    uint32_t postEmigrants(RegionMigrant *outbox) {
+        uint32_t n = 0;
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            leaving[t] = 0;
+            if (status[t] != TRAIN_STATUS_TRANSITIONING || travel_count[t] != 0) continue;
+            uint32_t dst = platform_region[topo.route_link[topo.route_arrival[route[t]]]];
+            if (dst == region) continue;
+            leaving[t] = 1;
+            outbox[n++] = {dst, train_id[t], line[t], route[t], station_at[t], load_count[t]};
+        }
+        return n;
+    }
+
+    // Takes in trains sent by other regions, sorted by id. They join as trains whose link countdown
+    // just finished, so step() moves them onto their platform at their place in id order.
+    void admit(const vector<RegionMigrant> &incoming) {
+        if (!incoming.empty()) regroup(incoming, false);
+    }
+
+    void step() {
+        countdownKernel(0, numTrains());
+        bool any_left = false;
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            if (!ready[t]) continue;
+            if (leaving[t]) {
+                link_occupied[topo.route_link[route[t]]] = 0;      // the other region takes the platform
+                any_left = true;
+            } else {
+                // arrivals from other regions clear a link this region never sets, which is harmless
+                transitionTrain(t);
+            }
+        }
+        if (any_left) regroup({}, true);
+    }
+
+    void writePositions(uint32_t *positions) const {
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            positions[train_id[t]] = status[t] == TRAIN_STATUS_TRANSITIONING
+                                     ? topo.route_link[route[t]] | REGION_ON_LINK : station_at[t];
+        }
+    }
+
+private:
+    const vector<uint32_t> &platform_region;
+    vector<uint32_t> owned_platforms;
+    uint32_t region;
+    vector<uint8_t> leaving;            // per train, handed to another region this tick
+
+    template<typename T>
+    static void gather(vector<T> &a, const vector<uint32_t> &from, T fill) {
+        vector<T> out(from.size());
+        for (size_t j = 0; j < from.size(); ++j) out[j] = from[j] < a.size() ? a[from[j]] : fill;
+        a.swap(out);
+    }
+
+    // Rebuilds the train arrays in id order: trains that left are dropped, incoming ones merged in.
+    // Holding areas link trains by index, so their links are renumbered.
+    void regroup(const vector<RegionMigrant> &incoming, bool drop_leaving) {
+        uint32_t n = numTrains();
+        vector<uint32_t> from;          // old index, or n + k for the k-th incoming train
+        size_t k = 0;
+        for (uint32_t t = 0; t <= n; ++t) {
+            while (k < incoming.size() && (t == n || incoming[k].train_id < train_id[t])) from.push_back(n + k++);
+            if (t < n && !(drop_leaving && leaving[t])) from.push_back(t);
+        }
+        vector<uint32_t> remap(n, SOA_NONE);
+        for (uint32_t j = 0; j < from.size(); ++j) {
+            if (from[j] < n) remap[from[j]] = j;
+        }
+
+        gather(status, from, (uint8_t)TRAIN_STATUS_TRANSITIONING);
+        gather(route, from, 0u);
+        gather(station_at, from, 0u);
+        gather(load_count, from, 0u);
+        gather(travel_count, from, 0u);
+        gather(queue_next, from, SOA_NONE);
+        gather(ready, from, (uint8_t)0);
+        gather(line, from, 0u);
+        gather(train_id, from, 0u);
+        gather(leaving, from, (uint8_t)0);
+        for (uint32_t j = 0; j < from.size(); ++j) {
+            if (from[j] >= n) {
+                const RegionMigrant &m = incoming[from[j] - n];
+                route[j] = m.route;
+                station_at[j] = m.station_at;
+                load_count[j] = m.load_count;
+                line[j] = m.line;
+                train_id[j] = m.train_id;
+            } else if (queue_next[j] != SOA_NONE) {
+                queue_next[j] = remap[queue_next[j]];
+            }
+        }
+        for (uint32_t p: owned_platforms) {
+            if (queue_head[p] == SOA_NONE) continue;
+            queue_head[p] = remap[queue_head[p]];
+            queue_tail[p] = remap[queue_tail[p]];
+        }
+        for (vector<uint32_t> &trains: line_trains) trains.clear();
+        for (uint32_t t = 0; t < numTrains(); ++t) line_trains[line[t]].push_back(t);
+    }
+};
+
+// Layout of the shared segment, all arrays follow the header.
+struct RegionShared {
+    ShmBarrier barrier;
+    /* double buffered by tick parity begin */
+    uint64_t *digests;                  // [2][regions]
+    RegionMigrant *outboxes;            // [2][outbox_base[regions]], region r writes from outbox_base[r]
+    uint32_t *outbox_counts;            // [2][regions]
+    uint32_t *positions;                // [2][trains], printed ticks
+    /* double buffered by tick parity end */
+};
+
+// Region process, never returns.
+void runRegion(const SoATopology &topo, const vector<uint32_t> &platform_region, uint32_t region,
+               uint32_t num_regions, const vector<uint32_t> &outbox_base, RegionShared *shm, size_t num_trains,
+               size_t ticks, const vector<size_t> &wanted, size_t num_lines, const DigestRecorder *digest) {
+    RegionEngine engine(topo, platform_region, region);
+    vector<RegionMigrant> incoming;
+    size_t outbox_size = outbox_base[num_regions];
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        size_t parity = tick & 1;
+        RegionMigrant *outboxes = shm->outboxes + parity * outbox_size;
+        uint32_t *outbox_counts = shm->outbox_counts + parity * num_regions;
+        engine.spawnTick(wanted);
+        outbox_counts[region] = engine.postEmigrants(outboxes + outbox_base[region]);
+        shm->barrier.wait();
+
+        incoming.clear();
+        for (uint32_t src = 0; src < num_regions; ++src) {
+            const RegionMigrant *outbox = outboxes + outbox_base[src];
+            for (uint32_t i = 0; i < outbox_counts[src]; ++i) {
+                if (outbox[i].dst_region == region) incoming.push_back(outbox[i]);
+            }
+        }
+        sort(incoming.begin(), incoming.end(), [](const RegionMigrant &a, const RegionMigrant &b) {
+            return a.train_id < b.train_id;
+        });
+        engine.admit(incoming);
+        engine.step();
+
+        if (tick >= ticks - num_lines) engine.writePositions(shm->positions + parity * num_trains);
+        if (digest != nullptr && digest->wants(tick)) {
+            shm->digests[parity * num_regions + region] = engine.canonicalDigest();
+        }
+    }
+    shm->barrier.wait();        // hands the last tick to the parent
+    _exit(0);
+}
+
+void simulateRegions(const Network &network,
+                     size_t ticks,
+                     const vector<size_t> &wanted,
+                     size_t num_lines,
+                     uint32_t num_regions,
+                     DigestRecorder *digest) {
+    SoATopology topo(network);
+    num_regions = max<uint32_t>(1, min<size_t>(num_regions, network.stations.size()));
+    vector<uint32_t> station_region = partitionStations(network, num_regions);
+    vector<uint32_t> platform_region;
+    for (Platform *plt: network.platforms) platform_region.push_back(station_region[plt->getStation()->getId()]);
+
+    // a link holds one train at a time, so a region sends at most one train per link into other regions
+    vector<uint32_t> outbox_base(num_regions + 1, 0);
+    for (Link *link: network.links) {
+        uint32_t src = station_region[link->getSrcStation()->getId()];
+        if (station_region[link->getDstStation()->getId()] != src) outbox_base[src + 1]++;
+    }
+    for (uint32_t r = 0; r < num_regions; ++r) outbox_base[r + 1] += outbox_base[r];
+
+    size_t num_trains = 0;
+    for (size_t n: wanted) num_trains += n;
+    size_t digests_at = (sizeof(RegionShared) + 7) & ~(size_t)7;
+    size_t outboxes_at = digests_at + 2 * num_regions * sizeof(uint64_t);
+    size_t counts_at = outboxes_at + 2 * outbox_base[num_regions] * sizeof(RegionMigrant);
+    size_t positions_at = counts_at + 2 * num_regions * sizeof(uint32_t);
+    size_t size = positions_at + 2 * num_trains * sizeof(uint32_t);
+
+    int shmid = shmget(IPC_PRIVATE, size, 0600 | IPC_CREAT);
+    if (shmid < 0) {
+        perror("shmget");
+        exit(1);
+    }
+    char *base = (char *)shmat(shmid, NULL, 0);
+    shmctl(shmid, IPC_RMID, 0);         // goes away once every process has detached or exited
+    if (base == (char *)-1) {
+        perror("shmat");
+        exit(1);
+    }
+    RegionShared *shm = (RegionShared *)base;
+    shm->barrier.init(num_regions + 1);
+    shm->digests = (uint64_t *)(base + digests_at);
+    shm->outboxes = (RegionMigrant *)(base + outboxes_at);
+    shm->outbox_counts = (uint32_t *)(base + counts_at);
+    shm->positions = (uint32_t *)(base + positions_at);
+
+    // children leave with _exit(), nothing buffered here may be written twice
+    fflush(stdout);
+    cout.flush();
+    vector<pid_t> children;
+    for (uint32_t r = 0; r < num_regions; ++r) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            runRegion(topo, platform_region, r, num_regions, outbox_base, shm, num_trains, ticks, wanted,
+                      num_lines, digest);
+        }
+        children.push_back(pid);
+    }
+
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, STDOUT_FILENO);
+    vector<vector<uint32_t>> line_ids(wanted.size());
+    vector<uint32_t> order = spawnOrder(wanted);
+    for (uint32_t id = 0; id < order.size(); ++id) line_ids[order[id]].push_back(id);
+
+    // after the barrier of tick T + 1 (or the regions' last one), tick T is complete
+    for (size_t done = 0; done <= ticks; ++done) {
+        shm->barrier.wait();
+        if (done == 0) continue;
+        size_t tick = done - 1;
+        if (tick >= ticks - num_lines) {    // print info
+            const uint32_t *positions = shm->positions + (tick & 1) * num_trains;
+            out.beginTick(tick);
+            for (uint32_t l: topo.print_order) {
+                size_t running = min<size_t>(wanted[l], 2 * (tick + 1));
+                for (size_t i = 0; i < running; ++i) {
+                    uint32_t id = line_ids[l][i], at = positions[id];
+                    if (at & REGION_ON_LINK) {
+                        out.trainOnLink(id, at & ~REGION_ON_LINK);
+                    } else {
+                        out.trainAtStation(id, at);
+                    }
+                }
+            }
+            out.endTick();
+        }
+        if (digest != nullptr && digest->wants(tick)) {
+            uint64_t sum = 0;
+            for (uint32_t r = 0; r < num_regions; ++r) sum += shm->digests[(tick & 1) * num_regions + r];
+            if (!digest->record(tick, sum)) {
+                // the regions may be anywhere in the next tick, no barrier is safe to join or skip
+                for (pid_t pid: children) kill(pid, SIGKILL);
+                break;
+            }
+        }
+    }
+
+    for (pid_t pid: children) waitpid(pid, NULL, 0);
+    shm->barrier.destroy();
+    shmdt(base);
+    flushOrExit(out);
+}
+
+#endif //CS3210_ASSIGNMENT1_REGION_ENGINE_H
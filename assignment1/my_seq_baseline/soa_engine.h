@@ -0,0 +1,540 @@
+#ifndef CS3210_ASSIGNMENT1_SOA_ENGINE_H
+#define CS3210_ASSIGNMENT1_SOA_ENGINE_H
+
+#include "main.h"
+#include "trace_formatter.h"
+#include "delta_trace.h"
+#include <cstdint>
+#include <cstdio>
+
+/* Structure-of-arrays version of simulate().
+ *
+ * Trains live in parallel arrays indexed by spawn order instead of heap allocated Train objects, and
+ * the two pure countdown states (loading passengers, transitioning) are decremented by a branch-free
+ * loop the compiler can vectorize. Only trains that are not simply counting down go through the
+ * scalar state machine, in the same order as the Train* loop, so the output is identical. */
+
+#define SOA_NONE UINT32_MAX
+
+// Line of every train in id order, following the spawning rule of simulate().
+vector<uint32_t> spawnOrder(const vector<size_t> &wanted) {
+    vector<uint32_t> order;
+    vector<size_t> spawned(wanted.size(), 0);
+    bool more = true;
+    while (more) {
+        more = false;
+        for (uint32_t l = 0; l < wanted.size(); ++l) {
+            unsigned num = spawned[l] + 2 <= wanted[l] ? 2 : (spawned[l] + 1 <= wanted[l] ? 1 : 0);
+            spawned[l] += num;
+            order.insert(order.end(), num, l);
+            more |= num > 0;
+        }
+    }
+    return order;
+}
+
+// Text pieces of the printed lines for the loaded network and these train counts.
+void makeTraceFragments(const Network &network, const vector<size_t> &wanted, TraceFragments &fragments) {
+    vector<uint32_t> order = spawnOrder(wanted);
+    for (uint32_t id = 0; id < order.size(); ++id) {
+        fragments.trains.add(network.lines[order[id]].label + to_string(id) + "-");
+    }
+    for (Station *st: network.stations) fragments.stations.add(st->getName());
+    for (Link *link: network.links) {
+        fragments.links.add(link->getSrcStation()->getName() + "->" + link->getDstStation()->getName());
+    }
+}
+
+// Position of every train's line in the print order, by train id.
+vector<uint32_t> trainPrintRanks(const Network &network, const vector<size_t> &wanted) {
+    vector<uint32_t> line_rank(network.lines.size()), rank;
+    for (uint32_t i = 0; i < network.print_order.size(); ++i) line_rank[network.print_order[i]] = i;
+    for (uint32_t l: spawnOrder(wanted)) rank.push_back(line_rank[l]);
+    return rank;
+}
+
+/* Copy of everything that changes once all trains have spawned. Two runs in the same snapshot state
+ * behave identically from then on. */
+struct SoASnapshot {
+    vector<uint8_t> status;
+    vector<uint32_t> route;
+    vector<uint32_t> station_at;
+    vector<uint32_t> load_count;
+    vector<uint32_t> travel_count;
+    vector<uint32_t> queue_next;
+    vector<uint8_t> platform_occupied;
+    vector<uint8_t> link_occupied;
+    vector<uint32_t> queue_head;
+    vector<uint32_t> queue_tail;
+    uint64_t hash;
+};
+
+template<typename T>
+bool writeArray(FILE *f, const vector<T> &a) {
+    return fwrite(a.data(), sizeof(T), a.size(), f) == a.size();
+}
+
+template<typename T>
+bool readArray(FILE *f, vector<T> &a, size_t n) {
+    a.resize(n);
+    return fread(a.data(), sizeof(T), n, f) == n;
+}
+
+inline uint64_t mixHash(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ (h >> 32);
+}
+
+template<typename T>
+uint64_t hashArray(uint64_t h, const vector<T> &a) {
+    const T *p = a.data();
+    size_t n = a.size();
+    uint64_t acc = n;
+    for (size_t i = 0; i < n; ++i) acc = acc * 0x100000001b3ull + p[i];
+    return mixHash(h, acc);
+}
+
+/* Canonical state digest, the same for every engine: a sum over trains and busy platforms of one
+ * mixed hash each. Summing makes it independent of visiting order, so engines that split the trains
+ * between threads or components add up their partial digests. Routes are counted from the start of
+ * the train's line, counters hold what the tick loop would hold. */
+inline uint64_t trainStateDigest(uint32_t id, uint32_t status, uint32_t line, uint32_t route, uint32_t station,
+                                 uint32_t load, uint32_t travel) {
+    uint64_t h = mixHash(0x5452414953544154ull, id);
+    h = mixHash(h, (uint64_t)status << 32 | line);
+    h = mixHash(h, (uint64_t)route << 32 | station);
+    return mixHash(h, (uint64_t)load << 32 | travel);
+}
+
+// Only platforms that are occupied, have a queue or whose link is taken contribute; the ids of the
+// queued trains are folded in with mixHash, in queue order.
+inline uint64_t platformStateSeed(uint32_t plt, bool occupied, bool link_occupied) {
+    return mixHash(0x504c4154464f524dull, (uint64_t)plt << 2 | (uint64_t)occupied << 1 | link_occupied);
+}
+
+#define USAGE_NONE UINT64_MAX
+
+// First tick each station's platforms were entered and each link was taken since the marks were last
+// reset. Popularity and distance are read at exactly these two points, see whatif.h.
+struct UsageMarks {
+    uint64_t tick = 0;                  // tick being simulated, set by the caller
+    vector<uint64_t> station;
+    vector<uint64_t> link;
+};
+
+// Flattened route tables of all lines, route ids are global across lines.
+struct SoATopology {
+    /* per route begin */
+    vector<uint32_t> route_station;
+    vector<uint32_t> route_link;        // == platform id of route_station heading to the next station
+    vector<uint32_t> route_arrival;
+    /* per route end */
+
+    vector<uint32_t> station_popularity;
+    vector<uint32_t> link_distance;
+
+    /* per line begin */
+    vector<uint32_t> line_route_base;
+    vector<uint32_t> line_num_stations;
+    /* per line end */
+    vector<uint32_t> print_order;
+
+    explicit SoATopology(const Network &network) {
+        for (const Line &line: network.lines) {
+            LineStationsManager *mgr = line.manager;
+            uint32_t base = route_station.size();
+            line_route_base.push_back(base);
+            line_num_stations.push_back(mgr->numStations());
+            for (unsigned r = 0; r < 2 * mgr->numStations(); ++r) {
+                const RouteCursor *cur = mgr->routeAt(r);
+                route_station.push_back(cur->station->getId());
+                route_link.push_back(cur->target_link ? cur->target_link->getId() : SOA_NONE);
+                route_arrival.push_back(base + cur->arrival);
+            }
+        }
+        for (Station *st: network.stations) station_popularity.push_back(st->getPopularity());
+        for (Link *link: network.links) link_distance.push_back(link->getDistance());
+        print_order.assign(network.print_order.begin(), network.print_order.end());
+    }
+
+    uint32_t numLines() const {
+        return line_route_base.size();
+    }
+
+    uint32_t spawnRoute(uint32_t line, bool at_terminal) const {
+        unsigned pos = at_terminal ? line_num_stations[line] - 1 : 0;
+        DIRECTION dir = pos == 0 ? DIRECTION_FORWARD : DIRECTION_BACKWARD;
+        return line_route_base[line] + LineStationsManager::routeIndex(pos, dir);
+    }
+};
+
+class SoAEngine {
+public:
+    explicit SoAEngine(const SoATopology &topo) : topo(topo) {
+        platform_occupied.assign(topo.link_distance.size(), 0);
+        link_occupied.assign(topo.link_distance.size(), 0);
+        queue_head.assign(topo.link_distance.size(), SOA_NONE);
+        queue_tail.assign(topo.link_distance.size(), SOA_NONE);
+        next_train_id = 0;
+        line_trains.resize(topo.numLines());
+        line_enabled.assign(topo.numLines(), 1);
+        spawned.assign(topo.numLines(), 0);
+        usage = nullptr;
+    }
+
+    void trackUsage(UsageMarks *marks) {
+        usage = marks;
+    }
+
+    // Only simulate the given lines. Train ids still count the trains of the other lines, so they
+    // match a run over the whole network.
+    void setLines(const vector<uint32_t> &lines) {
+        line_enabled.assign(topo.numLines(), 0);
+        for (uint32_t l: lines) line_enabled[l] = 1;
+    }
+
+    size_t numTrains() const {
+        return status.size();
+    }
+
+    void spawnTrain(uint32_t l, bool at_terminal) {
+        uint32_t t = status.size();
+        uint32_t r = topo.spawnRoute(l, at_terminal);
+        status.push_back(TRAIN_STATUS_INITIAL);
+        route.push_back(r);
+        station_at.push_back(topo.route_station[r]);
+        load_count.push_back(0);
+        travel_count.push_back(0);
+        queue_next.push_back(SOA_NONE);
+        ready.push_back(0);
+        line.push_back(l);
+        train_id.push_back(next_train_id++);
+        line_trains[l].push_back(t);
+
+        uint32_t plt = topo.route_link[r];
+        platform_occupied[plt] ? enterPlatformQueue(t, plt) : enterPlatform(t, plt);
+    }
+
+    // same spawning rule as simulate(): two trains per tick from both ends while possible, then one
+    void spawnTick(const vector<size_t> &wanted) {
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            size_t cur = spawned[l];
+            unsigned num = cur + 2 <= wanted[l] ? 2 : (cur + 1 <= wanted[l] ? 1 : 0);
+            spawned[l] += num;
+            if (!line_enabled[l]) {
+                next_train_id += num;
+                continue;
+            }
+            if (num >= 1) spawnTrain(l, false);
+            if (num == 2) spawnTrain(l, true);
+        }
+    }
+
+    void step() {
+        countdownKernel(0, numTrains());
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            if (ready[t]) transitionTrain(t);
+        }
+    }
+
+    bool allSpawned(const vector<size_t> &wanted) const {
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            if (spawned[l] < wanted[l]) return false;
+        }
+        return true;
+    }
+
+    uint64_t stateHash() const {
+        uint64_t h = 0;
+        h = hashArray(h, status);
+        h = hashArray(h, route);
+        h = hashArray(h, station_at);
+        h = hashArray(h, load_count);
+        h = hashArray(h, travel_count);
+        h = hashArray(h, queue_next);
+        h = hashArray(h, platform_occupied);
+        h = hashArray(h, link_occupied);
+        h = hashArray(h, queue_head);
+        h = hashArray(h, queue_tail);
+        return h;
+    }
+
+    void saveState(SoASnapshot &snap) const {
+        snap.status = status;
+        snap.route = route;
+        snap.station_at = station_at;
+        snap.load_count = load_count;
+        snap.travel_count = travel_count;
+        snap.queue_next = queue_next;
+        snap.platform_occupied = platform_occupied;
+        snap.link_occupied = link_occupied;
+        snap.queue_head = queue_head;
+        snap.queue_tail = queue_tail;
+        snap.hash = stateHash();
+    }
+
+    bool sameState(const SoASnapshot &snap) const {
+        return snap.status == status && snap.route == route && snap.station_at == station_at
+            && snap.load_count == load_count && snap.travel_count == travel_count
+            && snap.queue_next == queue_next && snap.platform_occupied == platform_occupied
+            && snap.link_occupied == link_occupied && snap.queue_head == queue_head
+            && snap.queue_tail == queue_tail;
+    }
+
+    // Raw dump of the mutable state, the checkpoint header records what it belongs to.
+    bool writeState(FILE *f) const {
+        uint64_t counts[2] = {next_train_id, numTrains()};
+        vector<uint64_t> line_spawned(spawned.begin(), spawned.end());
+        return fwrite(counts, sizeof(counts), 1, f) == 1 && writeArray(f, line_spawned)
+            && writeArray(f, status) && writeArray(f, route) && writeArray(f, station_at)
+            && writeArray(f, load_count) && writeArray(f, travel_count) && writeArray(f, queue_next)
+            && writeArray(f, line) && writeArray(f, train_id)
+            && writeArray(f, platform_occupied) && writeArray(f, link_occupied)
+            && writeArray(f, queue_head) && writeArray(f, queue_tail);
+    }
+
+    // False when f ends early or holds a state these train counts cannot reach; nothing read is
+    // trusted as a size or an index before it is checked.
+    bool readState(FILE *f, const vector<size_t> &wanted) {
+        uint64_t counts[2];
+        vector<uint64_t> line_spawned;
+        if (fread(counts, sizeof(counts), 1, f) != 1 || !readArray(f, line_spawned, topo.numLines())) return false;
+        uint64_t n = 0, total = 0;
+        for (uint32_t l = 0; l < topo.numLines(); ++l) {
+            if (line_spawned[l] > wanted[l]) return false;
+            n += line_spawned[l];
+            total += wanted[l];
+        }
+        if (counts[1] != n || counts[0] < n || counts[0] > total) return false;
+        spawned.assign(line_spawned.begin(), line_spawned.end());
+        next_train_id = counts[0];
+        if (!(readArray(f, status, n) && readArray(f, route, n) && readArray(f, station_at, n)
+              && readArray(f, load_count, n) && readArray(f, travel_count, n) && readArray(f, queue_next, n)
+              && readArray(f, line, n) && readArray(f, train_id, n)
+              && readArray(f, platform_occupied, platform_occupied.size())
+              && readArray(f, link_occupied, link_occupied.size())
+              && readArray(f, queue_head, queue_head.size()) && readArray(f, queue_tail, queue_tail.size()))) {
+            return false;
+        }
+        auto inQueue = [n](uint32_t t) { return t < n || t == SOA_NONE; };
+        for (uint32_t t = 0; t < n; ++t) {
+            if (status[t] >= NUM_TRAIN_STATUSES || route[t] >= topo.route_station.size()
+                || station_at[t] >= topo.station_popularity.size() || line[t] >= topo.numLines()
+                || train_id[t] >= next_train_id || !inQueue(queue_next[t])) {
+                return false;
+            }
+        }
+        for (uint32_t p = 0; p < queue_head.size(); ++p) {
+            if (!inQueue(queue_head[p]) || !inQueue(queue_tail[p])) return false;
+        }
+        ready.assign(n, 0);
+        for (vector<uint32_t> &trains: line_trains) trains.clear();
+        for (uint32_t t = 0; t < n; ++t) line_trains[line[t]].push_back(t);
+        return true;
+    }
+
+    // Canonical digest of the state after `tick`. Engines that do not keep the countdowns up to date
+    // pass the tick each countdown finishes at; the counters are then derived from it.
+    uint64_t canonicalDigest(const uint64_t *finish_at = nullptr, uint64_t tick = 0) const {
+        uint64_t sum = 0;
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            uint32_t load = load_count[t], travel = travel_count[t];
+            if (finish_at != nullptr && status[t] == TRAIN_STATUS_LOADING_PASSENGERS) load = finish_at[t] - 1 - tick;
+            if (finish_at != nullptr && status[t] == TRAIN_STATUS_TRANSITIONING) travel = finish_at[t] - 1 - tick;
+            sum += trainStateDigest(train_id[t], status[t], line[t], route[t] - topo.line_route_base[line[t]],
+                                    station_at[t], load, travel);
+        }
+        for (uint32_t p = 0; p < platform_occupied.size(); ++p) {
+            if (!platform_occupied[p] && !link_occupied[p] && queue_head[p] == SOA_NONE) continue;
+            uint64_t h = platformStateSeed(p, platform_occupied[p], link_occupied[p]);
+            for (uint32_t q = queue_head[p]; q != SOA_NONE; q = queue_next[q]) h = mixHash(h, train_id[q]);
+            sum += h;
+        }
+        return sum;
+    }
+
+    void countStatuses(size_t counts[NUM_TRAIN_STATUSES]) const {
+        for (unsigned s = 0; s < NUM_TRAIN_STATUSES; ++s) counts[s] = 0;
+        for (uint8_t s: status) counts[s]++;
+    }
+
+    // trains in the longest holding area
+    uint32_t longestQueue() const {
+        uint32_t longest = 0;
+        for (uint32_t p = 0; p < queue_head.size(); ++p) {
+            uint32_t n = 0;
+            for (uint32_t q = queue_head[p]; q != SOA_NONE; q = queue_next[q]) n++;
+            longest = max(longest, n);
+        }
+        return longest;
+    }
+
+    void writeTrain(uint32_t t, TraceFormatter &out) const {
+        if (status[t] == TRAIN_STATUS_TRANSITIONING) {
+            out.trainOnLink(train_id[t], topo.route_link[route[t]]);
+        } else {
+            out.trainAtStation(train_id[t], station_at[t]);
+        }
+    }
+
+    void writeLine(uint32_t l, TraceFormatter &out) const {
+        for (uint32_t t: line_trains[l]) writeTrain(t, out);
+    }
+
+    void writeTick(size_t tick, TraceFormatter &out) const {
+        out.beginTick(tick);
+        for (uint32_t l: topo.print_order) writeLine(l, out);
+        out.endTick();
+    }
+
+    // the same tick as changes only; spawn order is id order
+    void writeDelta(size_t tick, DeltaTraceWriter &out) const {
+        out.beginTick(tick);
+        for (uint32_t t = 0; t < numTrains(); ++t) {
+            out.train(train_id[t], status[t] == TRAIN_STATUS_TRANSITIONING ? linkLocation(topo.route_link[route[t]])
+                                                                          : stationLocation(station_at[t]));
+        }
+        out.endTick();
+    }
+
+protected:
+    const SoATopology &topo;
+
+    /* per train begin, direction is the low bit of the route id */
+    vector<uint8_t> status;
+    vector<uint32_t> route;
+    vector<uint32_t> station_at;        // station shown when not transitioning
+    vector<uint32_t> load_count;
+    vector<uint32_t> travel_count;
+    vector<uint32_t> queue_next;        // next train in the same holding area
+    vector<uint8_t> ready;              // needs the scalar state machine this tick
+    vector<uint32_t> line;
+    vector<uint32_t> train_id;          // global id, differs from the index when lines are skipped
+    /* per train end */
+
+    /* per platform / link begin */
+    vector<uint8_t> platform_occupied;
+    vector<uint8_t> link_occupied;
+    vector<uint32_t> queue_head;
+    vector<uint32_t> queue_tail;
+    /* per platform / link end */
+
+    /* per line begin */
+    vector<vector<uint32_t>> line_trains;
+    vector<uint8_t> line_enabled;
+    vector<size_t> spawned;             // trains spawned so far, including skipped lines
+    /* per line end */
+    uint32_t next_train_id;
+    UsageMarks *usage;
+
+    // Decrements trains that are only counting down and flags everyone else for the scalar pass.
+    void countdownKernel(uint32_t begin, uint32_t end) {
+        uint8_t *st = status.data();
+        uint32_t *lc = load_count.data();
+        uint32_t *tc = travel_count.data();
+        uint8_t *rd = ready.data();
+#pragma omp simd
+        for (uint32_t t = begin; t < end; ++t) {
+            uint32_t l = lc[t], c = tc[t];
+            uint32_t load_dec = (st[t] == TRAIN_STATUS_LOADING_PASSENGERS) & (l != 0);
+            uint32_t travel_dec = (st[t] == TRAIN_STATUS_TRANSITIONING) & (c != 0);
+            lc[t] = l - load_dec;
+            tc[t] = c - travel_dec;
+            rd[t] = !(load_dec | travel_dec);
+        }
+    }
+
+    /* transitions begin, mirror the Train methods */
+    void enterPlatform(uint32_t t, uint32_t plt) {
+        status[t] = TRAIN_STATUS_IN_PLATFORM;
+        station_at[t] = topo.route_station[route[t]];
+        load_count[t] = topo.station_popularity[station_at[t]];
+        platform_occupied[plt] = 1;
+        if (usage != nullptr && usage->station[station_at[t]] == USAGE_NONE) usage->station[station_at[t]] = usage->tick;
+    }
+
+    void enterPlatformQueue(uint32_t t, uint32_t plt) {
+        status[t] = TRAIN_STATUS_QUEUEING_FOR_PLATFORM;
+        queue_next[t] = SOA_NONE;
+        if (queue_tail[plt] == SOA_NONE) {
+            queue_head[plt] = t;
+        } else {
+            queue_next[queue_tail[plt]] = t;
+        }
+        queue_tail[plt] = t;
+    }
+
+    // returns the train moved in from the holding area, if any
+    uint32_t leavePlatform(uint32_t plt) {
+        platform_occupied[plt] = 0;
+        uint32_t first = queue_head[plt];
+        if (first != SOA_NONE) {
+            enterPlatform(first, plt);
+            queue_head[plt] = queue_next[first];
+            queue_next[first] = SOA_NONE;       // keeps equal states byte-identical
+            if (queue_head[plt] == SOA_NONE) queue_tail[plt] = SOA_NONE;
+        }
+        return first;
+    }
+
+    void waitForAnotherTickToLink(uint32_t t, uint32_t link) {
+        status[t] = TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK;
+        travel_count[t] = topo.link_distance[link];
+        link_occupied[link] = 1;
+        if (usage != nullptr && usage->link[link] == USAGE_NONE) usage->link[link] = usage->tick;
+    }
+    /* transitions end */
+
+    void transitionTrain(uint32_t t) {
+        switch (status[t]) {
+            case TRAIN_STATUS_INITIAL:
+            case TRAIN_STATUS_QUEUEING_FOR_PLATFORM: {
+                // do nothing
+                break;
+            }
+            case TRAIN_STATUS_IN_PLATFORM: {
+                status[t] = TRAIN_STATUS_OPENING_DOOR;
+                break;
+            }
+            case TRAIN_STATUS_OPENING_DOOR: {
+                status[t] = TRAIN_STATUS_LOADING_PASSENGERS;
+                load_count[t]--;
+                break;
+            }
+            case TRAIN_STATUS_LOADING_PASSENGERS:       // only reached once the counter finished
+            case TRAIN_STATUS_WAITING_FOR_LINK: {
+                uint32_t link = topo.route_link[route[t]];
+                if (!link_occupied[link]) {
+                    waitForAnotherTickToLink(t, link);
+                } else {
+                    status[t] = TRAIN_STATUS_WAITING_FOR_LINK;
+                }
+                break;
+            }
+            case TRAIN_STATUS_WAITING_FOR_ANOTHER_TICK: {
+                uint32_t link = topo.route_link[route[t]];
+                leavePlatform(link);
+                status[t] = TRAIN_STATUS_TRANSITIONING;
+                link_occupied[link] = 1;
+                travel_count[t]--;
+                break;
+            }
+            case TRAIN_STATUS_TRANSITIONING: {          // only reached once the counter finished
+                link_occupied[topo.route_link[route[t]]] = 0;
+                route[t] = topo.route_arrival[route[t]];
+                uint32_t plt = topo.route_link[route[t]];
+                if (platform_occupied[plt]) {
+                    enterPlatformQueue(t, plt);
+                } else {
+                    enterPlatform(t, plt);
+                    status[t] = TRAIN_STATUS_OPENING_DOOR;
+                }
+                break;
+            }
+            default: cout<<"Unexpected status of train id "<<train_id[t]<<endl; break;
+        }
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_SOA_ENGINE_H
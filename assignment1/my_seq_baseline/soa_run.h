@@ -0,0 +1,164 @@
+#ifndef CS3210_ASSIGNMENT1_SOA_RUN_H
+#define CS3210_ASSIGNMENT1_SOA_RUN_H
+
+#include "soa_engine.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "digest.h"
+#include "telemetry.h"
+
+/* Finds a repeating global state with Brent's algorithm on every ff_interval-th tick once all trains have
+ * spawned. A snapshot is kept at power-of-two sample counts; when a later sample equals it the state
+ * has cycled, and whole periods are skipped up to the first printed tick or the next checkpoint. */
+class CycleDetector {
+public:
+    explicit CycleDetector(size_t interval) {
+        this->interval = interval;
+        this->have_snapshot = false;
+        this->power = 1;
+        this->samples = 0;
+        this->period = 0;
+    }
+
+    // Called with the number of ticks simulated so far, returns how many ticks can be skipped without
+    // passing target. Once the period is known every later call skips whole periods again.
+    size_t check(const SoAEngine &engine, size_t ticks_done, size_t target) {
+        if (ticks_done >= target) return 0;
+        if (this->period > 0) return (target - ticks_done) / this->period * this->period;
+        if (this->interval == 0 || ticks_done % this->interval != 0) return 0;
+
+        uint64_t hash = engine.stateHash();
+        if (this->have_snapshot && hash == this->snapshot.hash && engine.sameState(this->snapshot)) {
+            this->period = ticks_done - this->snapshot_tick;
+            return (target - ticks_done) / this->period * this->period;
+        }
+        if (!this->have_snapshot || ++this->samples == this->power) {
+            engine.saveState(this->snapshot);
+            this->snapshot_tick = ticks_done;
+            this->have_snapshot = true;
+            this->power *= 2;
+            this->samples = 0;
+        }
+        return 0;
+    }
+
+private:
+    size_t interval;
+    size_t period;                      // of the state cycle, 0 until one is found
+    bool have_snapshot;
+    SoASnapshot snapshot;
+    size_t snapshot_tick;
+    size_t power;
+    size_t samples;
+};
+
+struct SoARunOptions {
+    size_t ff_interval = 0;             // check for a state cycle every ff_interval ticks, 0 = never
+    size_t save_at = SIZE_MAX;          // write a checkpoint once this many ticks are simulated
+    size_t save_every = 0;              // and every save_every ticks, 0 = never
+    string checkpoint_path;
+    string resume_path;                 // continue from this checkpoint instead of tick 0
+    RunProfile *profile = nullptr;      // phase times and status histograms go here when set
+    DigestRecorder *digest = nullptr;   // state digests go here when set
+    TelemetryPublisher *telemetry = nullptr;    // live progress goes here when set
+    int delta_fd = -1;                  // printed ticks go here as a transition trace instead, see delta_trace.h
+};
+
+// First number of simulated ticks from done on that a checkpoint is saved at, SIZE_MAX if none.
+inline size_t nextSaveTick(const SoARunOptions &opts, size_t done) {
+    size_t next = opts.save_at >= done ? opts.save_at : SIZE_MAX;
+    if (opts.save_every > 0) next = min(next, (done + opts.save_every - 1) / opts.save_every * opts.save_every);
+    return next;
+}
+
+// One SoA run over an already built topology, printing to fd. Only reads the network and topology,
+// so concurrent runs can share them. Returns the errno of a failed write to fd, 0 if all of it went out.
+int runSoA(const Network &network,
+            const SoATopology &topo,
+            size_t ticks,
+            const vector<size_t> &wanted,
+            size_t num_lines,
+            const SoARunOptions &opts,
+            int fd) {
+    SoAEngine engine(topo);
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, opts.delta_fd < 0 ? fd : -1);
+    DeltaTraceWriter *delta = nullptr;
+    if (opts.delta_fd >= 0) delta = new DeltaTraceWriter(fragments, trainPrintRanks(network, wanted), opts.delta_fd);
+    const size_t print_from = num_lines <= ticks ? ticks - num_lines : ticks;
+    CycleDetector cycles(opts.ff_interval);
+
+    uint64_t start = 0;
+    if (!opts.resume_path.empty() && !loadCheckpoint(opts.resume_path, engine, topo, wanted, start)) {
+        exit(2);
+    }
+
+    PhaseClock clock(opts.profile);
+    size_t status_counts[NUM_TRAIN_STATUSES];
+    if (opts.telemetry != nullptr) opts.telemetry->publish(engine, start, ticks, 0, opts.profile);
+    size_t tick = start;
+    for (; tick < ticks; ++tick) {
+        engine.spawnTick(wanted);
+        clock.lap(PHASE_SPAWN);
+        engine.step();
+        if (opts.profile != nullptr) {
+            engine.countStatuses(status_counts);
+            opts.profile->sampleTick(status_counts);
+        }
+        if (opts.digest != nullptr && opts.digest->wants(tick) && !opts.digest->record(tick, engine.canonicalDigest())) {
+            break;
+        }
+        clock.lap(PHASE_UPDATE);
+        if (tick >= print_from) {    // print info
+            if (delta != nullptr) {
+                engine.writeDelta(tick, *delta);
+            } else {
+                engine.writeTick(tick, out);
+            }
+            clock.lap(PHASE_FORMAT);
+        } else if (engine.allSpawned(wanted)) {
+            tick += cycles.check(engine, tick + 1, min(print_from, nextSaveTick(opts, tick + 1)));
+            clock.lap(PHASE_UPDATE);
+        }
+
+        size_t done = tick + 1;
+        if ((done == opts.save_at || (opts.save_every > 0 && done % opts.save_every == 0))
+            && !saveCheckpoint(opts.checkpoint_path, engine, topo, done, wanted)) {
+            exit(2);
+        }
+        if (opts.telemetry != nullptr && done >= opts.telemetry->nextTick()) {
+            opts.telemetry->publish(engine, done, ticks, delta != nullptr ? delta->flushNanos() : out.flushNanos(), opts.profile);
+        }
+    }
+    out.flush();
+    if (delta != nullptr && !delta->finish(max(print_from, (size_t)start))) {
+        cerr << "Failed to write the transition trace\n";
+        exit(2);
+    }
+    clock.lap(PHASE_FORMAT);
+    const uint64_t flush_ns = delta != nullptr ? delta->flushNanos() : out.flushNanos();
+    if (opts.profile != nullptr) opts.profile->moveToFlush(flush_ns);
+    // a digest divergence stops the run early
+    const uint64_t ticks_done = tick < ticks ? tick + 1 : ticks;
+    if (opts.telemetry != nullptr && ticks_done != opts.telemetry->lastTick()) {
+        opts.telemetry->publish(engine, ticks_done, ticks, flush_ns, opts.profile);
+    }
+    delete delta;
+    return out.writeError();
+}
+
+void simulateSoA(const Network &network,
+                 size_t ticks,
+                 const vector<size_t> &wanted,
+                 size_t num_lines,
+                 const SoARunOptions &opts) {
+    SoATopology topo(network);
+    int error = runSoA(network, topo, ticks, wanted, num_lines, opts, STDOUT_FILENO);
+    if (error != 0) {
+        fprintf(stderr, "Failed to write the trace: %s\n", strerror(error));
+        exit(2);
+    }
+}
+
+#endif //CS3210_ASSIGNMENT1_SOA_RUN_H
@@ -0,0 +1,148 @@
+#ifndef CS3210_ASSIGNMENT1_STATS_H
+#define CS3210_ASSIGNMENT1_STATS_H
+
+#include "main.h"
+#include <cstdint>
+#include <cstdio>
+
+/* Operational statistics of a simulate() run, built with -DMRT_STATS.
+ *
+ * Nothing is scanned per tick: the Train transitions that change a platform, link or holding area
+ * report it here, and every quantity is time-weighted by the ticks between two such changes.
+ * Without MRT_STATS the MRT_STAT() hooks and the Train fields they use are compiled out. */
+
+#ifdef MRT_STATS
+#define MRT_STAT(call) (call)
+#else
+#define MRT_STAT(call) ((void)0)
+#endif
+
+#define STATS_NOT_BUSY UINT64_MAX
+#define STATS_QUEUE_BUCKETS 16          // queue lengths 0..14, the last bucket holds 15 and longer
+
+inline void writeJsonString(FILE *f, const string &s) {
+    fputc('"', f);
+    for (char c: s) {
+        if (c == '"' || c == '\\') fputc('\\', f);
+        fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+class SimStats {
+public:
+    uint64_t tick;                      // tick being simulated, set by the tick loop
+
+    explicit SimStats(const Network &network) : network(network) {
+        this->tick = 0;
+        this->platforms.resize(network.platforms.size());
+        this->link_busy_since.assign(network.links.size(), STATS_NOT_BUSY);
+        this->link_busy_ticks.assign(network.links.size(), 0);
+        this->station_arrivals.assign(network.stations.size(), 0);
+        this->station_queued_arrivals.assign(network.stations.size(), 0);
+        this->station_wait_ticks.assign(network.stations.size(), 0);
+    }
+
+    /* transition hooks begin */
+    void platformEntered(unsigned plt, unsigned station, bool from_queue, uint64_t queued_since) {
+        this->platforms[plt].busy_since = this->tick;
+        this->station_arrivals[station]++;
+        if (from_queue) {
+            this->station_queued_arrivals[station]++;
+            this->station_wait_ticks[station] += this->tick - queued_since;
+        }
+    }
+
+    void platformLeft(unsigned plt) {
+        PlatformStats &p = this->platforms[plt];
+        p.busy_ticks += this->tick - p.busy_since;
+        p.busy_since = STATS_NOT_BUSY;
+    }
+
+    void queueChanged(unsigned plt, int delta) {
+        PlatformStats &p = this->platforms[plt];
+        p.queue_ticks[min<uint32_t>(p.queue_length, STATS_QUEUE_BUCKETS - 1)] += this->tick - p.queue_since;
+        p.queue_since = this->tick;
+        p.queue_length += delta;
+        p.max_queue = max(p.max_queue, p.queue_length);
+    }
+
+    // a link is busy from the tick it is reserved until the train leaves it
+    void linkTaken(unsigned link) {
+        if (this->link_busy_since[link] == STATS_NOT_BUSY) this->link_busy_since[link] = this->tick;
+    }
+
+    void linkReleased(unsigned link) {
+        this->link_busy_ticks[link] += this->tick - this->link_busy_since[link];
+        this->link_busy_since[link] = STATS_NOT_BUSY;
+    }
+    /* transition hooks end */
+
+    // Closes the intervals still open after `ticks` ticks and writes everything as one JSON object.
+    void writeJson(FILE *f, uint64_t ticks) {
+        this->tick = ticks;
+        double span = ticks > 0 ? (double)ticks : 1.0;
+
+        fprintf(f, "{\n  \"ticks\": %llu,\n  \"platforms\": [", (unsigned long long)ticks);
+        for (size_t i = 0; i < this->platforms.size(); ++i) {
+            PlatformStats &p = this->platforms[i];
+            if (p.busy_since != STATS_NOT_BUSY) platformLeft(i);
+            queueChanged(i, 0);
+            Platform *plt = this->network.platforms[i];
+            fprintf(f, "%s\n    {\"id\": %zu, \"station\": ", i == 0 ? "" : ",", i);
+            writeJsonString(f, plt->getStation()->getName());
+            fprintf(f, ", \"towards\": ");
+            writeJsonString(f, plt->getDstStation()->getName());
+            fprintf(f, ", \"utilization\": %.6f, \"max_queue\": %u, \"queue_length_ticks\": [",
+                    p.busy_ticks / span, p.max_queue);
+            for (unsigned b = 0; b < STATS_QUEUE_BUCKETS; ++b) {
+                fprintf(f, "%s%llu", b == 0 ? "" : ", ", (unsigned long long)p.queue_ticks[b]);
+            }
+            fprintf(f, "]}");
+        }
+
+        fprintf(f, "\n  ],\n  \"links\": [");
+        for (size_t i = 0; i < this->link_busy_ticks.size(); ++i) {
+            if (this->link_busy_since[i] != STATS_NOT_BUSY) linkReleased(i);
+            Link *link = this->network.links[i];
+            fprintf(f, "%s\n    {\"id\": %zu, \"from\": ", i == 0 ? "" : ",", i);
+            writeJsonString(f, link->getSrcStation()->getName());
+            fprintf(f, ", \"to\": ");
+            writeJsonString(f, link->getDstStation()->getName());
+            fprintf(f, ", \"occupancy\": %.6f}", this->link_busy_ticks[i] / span);
+        }
+
+        fprintf(f, "\n  ],\n  \"stations\": [");
+        for (size_t i = 0; i < this->station_arrivals.size(); ++i) {
+            uint64_t arrivals = this->station_arrivals[i];
+            fprintf(f, "%s\n    {\"name\": ", i == 0 ? "" : ",");
+            writeJsonString(f, this->network.stations[i]->getName());
+            fprintf(f, ", \"arrivals\": %llu, \"queued_arrivals\": %llu, \"avg_wait\": %.6f}",
+                    (unsigned long long)arrivals, (unsigned long long)this->station_queued_arrivals[i],
+                    arrivals > 0 ? (double)this->station_wait_ticks[i] / arrivals : 0.0);
+        }
+        fprintf(f, "\n  ]\n}\n");
+    }
+
+private:
+    struct PlatformStats {
+        uint64_t busy_since = STATS_NOT_BUSY;
+        uint64_t busy_ticks = 0;
+        uint32_t queue_length = 0;
+        uint32_t max_queue = 0;
+        uint64_t queue_since = 0;
+        uint64_t queue_ticks[STATS_QUEUE_BUCKETS] = {};     // ticks spent at each holding-area length
+    };
+
+    const Network &network;
+    vector<PlatformStats> platforms;
+    vector<uint64_t> link_busy_since;
+    vector<uint64_t> link_busy_ticks;
+    /* per station begin */
+    vector<uint64_t> station_arrivals;
+    vector<uint64_t> station_queued_arrivals;
+    vector<uint64_t> station_wait_ticks;        // ticks spent in holding areas, over all arrivals
+    /* per station end */
+};
+
+#endif //CS3210_ASSIGNMENT1_STATS_H
@@ -0,0 +1,187 @@
+#ifndef CS3210_ASSIGNMENT1_TELEMETRY_H
+#define CS3210_ASSIGNMENT1_TELEMETRY_H
+
+#include "profile.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+/* Live progress of a run in System V shared memory, read by ./monitor (monitor.cpp).
+ *
+ * The segment is keyed with ftok(path, TELEMETRY_PROJECT), like L1_code/semaph_shm.c, so a monitor
+ * started separately finds it through the same file. It holds a ring of TELEMETRY_SLOTS samples with
+ * one writer, the simulation thread, which never waits: sample n goes to slot n % TELEMETRY_SLOTS,
+ * whose seq is odd while it is written and 2n + 2 once it is complete, and readers copy a slot and
+ * retry when seq changed under them (a seqlock). A sample is taken every `every` ticks, which is
+ * a clock read and a pass over the trains; the run loop only compares the tick in between.
+ *
+ * The segment is removed when the run ends, also when it ends through exit(); monitors still attached
+ * keep their mapping and see `finished` set. */
+
+#define TELEMETRY_MAGIC 0x314d454c4554524dull     // "MRTELEM1"
+#define TELEMETRY_PROJECT 'T'
+#define TELEMETRY_SLOTS 256
+
+struct TelemetrySample {
+    atomic<uint64_t> seq;
+    uint64_t ticks_done;
+    uint64_t ticks;                     // N of the run
+    uint64_t wall_ns;                   // since the run started
+    double ticks_per_second;            // since the previous sample
+    uint64_t trains;
+    uint64_t status[NUM_TRAIN_STATUSES];
+    uint64_t longest_queue;             // trains queueing for one platform
+    uint64_t flush_ns;                  // spent waiting for the trace writer
+    uint64_t phase_ns[NUM_PHASES];      // only with --profile
+};
+
+struct TelemetryRing {
+    uint64_t magic;
+    int32_t pid;
+    atomic<uint32_t> finished;
+    atomic<uint64_t> published;         // samples written so far
+    TelemetrySample slots[TELEMETRY_SLOTS];
+};
+
+// Attaches to the ring of path, creating both if asked to; nullptr and a message on failure.
+inline TelemetryRing *attachTelemetry(const string &path, bool create, int &shmid) {
+    if (create) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0) close(fd);
+    }
+    key_t key = ftok(path.c_str(), TELEMETRY_PROJECT);
+    if (key < 0) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    shmid = shmget(key, sizeof(TelemetryRing), create ? 0644 | IPC_CREAT : 0);
+    if (shmid < 0 && create && errno == EINVAL) {
+        // left behind by a run that was killed, with another layout
+        int stale = shmget(key, 0, 0);
+        if (stale >= 0) shmctl(stale, IPC_RMID, 0);
+        shmid = shmget(key, sizeof(TelemetryRing), 0644 | IPC_CREAT);
+    }
+    if (shmid < 0) {
+        perror("shmget");
+        return nullptr;
+    }
+    void *p = shmat(shmid, NULL, create ? 0 : SHM_RDONLY);
+    if (p == (void *)-1) {
+        perror("shmat");
+        return nullptr;
+    }
+    return (TelemetryRing *)p;
+}
+
+// segment of the live publisher, removed at exit() if the run does not get to delete it
+inline int telemetry_shmid = -1;
+
+inline void removeTelemetrySegment() {
+    if (telemetry_shmid >= 0) shmctl(telemetry_shmid, IPC_RMID, 0);
+    telemetry_shmid = -1;
+}
+
+// Copies the newest sample; false if there is none yet or the writer kept overtaking the copy.
+inline bool readLatestSample(const TelemetryRing *ring, TelemetrySample &sample, uint64_t &index) {
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        uint64_t n = ring->published.load(memory_order_acquire);
+        if (n == 0) return false;
+        const TelemetrySample &slot = ring->slots[(n - 1) % TELEMETRY_SLOTS];
+        uint64_t before = slot.seq.load(memory_order_acquire);
+        sample.ticks_done = slot.ticks_done;
+        sample.ticks = slot.ticks;
+        sample.wall_ns = slot.wall_ns;
+        sample.ticks_per_second = slot.ticks_per_second;
+        sample.trains = slot.trains;
+        memcpy(sample.status, slot.status, sizeof(sample.status));
+        sample.longest_queue = slot.longest_queue;
+        sample.flush_ns = slot.flush_ns;
+        memcpy(sample.phase_ns, slot.phase_ns, sizeof(sample.phase_ns));
+        atomic_thread_fence(memory_order_acquire);
+        if (before == 2 * (n - 1) + 2 && slot.seq.load(memory_order_relaxed) == before) {
+            index = n - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+class TelemetryPublisher {
+public:
+    TelemetryPublisher(const string &path, uint64_t every) {
+        this->every = max<uint64_t>(every, 1);
+        this->next_tick = 0;
+        this->ring = attachTelemetry(path, true, this->shmid);
+        if (this->ring == nullptr) return;
+        memset((void *)this->ring, 0, sizeof(TelemetryRing));
+        this->ring->magic = TELEMETRY_MAGIC;
+        this->ring->pid = getpid();
+        if (telemetry_shmid < 0) atexit(removeTelemetrySegment);
+        telemetry_shmid = this->shmid;
+        this->start_ns = this->last_ns = monotonicNanos();
+        this->last_tick = 0;
+    }
+
+    ~TelemetryPublisher() {
+        if (this->ring == nullptr) return;
+        this->ring->finished.store(1, memory_order_release);
+        removeTelemetrySegment();
+        shmdt((void *)this->ring);
+    }
+
+    bool ok() const {
+        return this->ring != nullptr;
+    }
+
+    // the run loop calls publish() once this many ticks are done
+    uint64_t nextTick() const {
+        return this->next_tick;
+    }
+
+    // ticks done at the last sample
+    uint64_t lastTick() const {
+        return this->last_tick;
+    }
+
+    template<typename Engine>
+    void publish(const Engine &engine, uint64_t ticks_done, uint64_t ticks, uint64_t flush_ns,
+                 const RunProfile *profile) {
+        uint64_t now = monotonicNanos();
+        uint64_t n = this->ring->published.load(memory_order_relaxed);
+        TelemetrySample &slot = this->ring->slots[n % TELEMETRY_SLOTS];
+        slot.seq.store(2 * n + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        slot.ticks_done = ticks_done;
+        slot.ticks = ticks;
+        slot.wall_ns = now - this->start_ns;
+        slot.ticks_per_second = now > this->last_ns ? (ticks_done - this->last_tick) * 1e9 / (now - this->last_ns) : 0.0;
+        size_t counts[NUM_TRAIN_STATUSES];
+        engine.countStatuses(counts);
+        for (unsigned s = 0; s < NUM_TRAIN_STATUSES; ++s) slot.status[s] = counts[s];
+        slot.trains = engine.numTrains();
+        slot.longest_queue = engine.longestQueue();
+        slot.flush_ns = flush_ns;
+        for (unsigned p = 0; p < NUM_PHASES; ++p) slot.phase_ns[p] = profile != nullptr ? profile->phaseNanos((PHASE)p) : 0;
+
+        slot.seq.store(2 * n + 2, memory_order_release);
+        this->ring->published.store(n + 1, memory_order_release);
+        this->last_ns = now;
+        this->last_tick = ticks_done;
+        this->next_tick = (ticks_done / this->every + 1) * this->every;
+    }
+
+private:
+    TelemetryRing *ring;
+    int shmid;
+    uint64_t every;
+    uint64_t next_tick;
+    uint64_t start_ns;
+    uint64_t last_ns;
+    uint64_t last_tick;
+};
+
+#endif //CS3210_ASSIGNMENT1_TELEMETRY_H
@@ -0,0 +1,73 @@
+#ifndef CS3210_ASSIGNMENT1_THREAD_POOL_H
+#define CS3210_ASSIGNMENT1_THREAD_POOL_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/* Work-stealing pool for a fixed set of independent tasks.
+ *
+ * Tasks are dealt round robin onto one deque per worker. A worker takes from the back of its own deque
+ * and, once that is empty, steals from the front of the others, so a few long jobs do not leave the
+ * remaining workers idle. No task submits new tasks, so a worker that finds every deque empty is done. */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned num_workers) : queues(num_workers == 0 ? 1 : num_workers) {
+    }
+
+    void submit(function<void()> task) {
+        this->queues[this->next_queue].tasks.push_back(std::move(task));
+        this->next_queue = (this->next_queue + 1) % this->queues.size();
+    }
+
+    // Runs every submitted task, returns once all of them have finished.
+    void run() {
+        vector<thread> workers;
+        for (unsigned w = 1; w < this->queues.size(); ++w) {
+            workers.emplace_back([this, w] { work(w); });
+        }
+        work(0);
+        for (thread &t: workers) t.join();
+    }
+
+private:
+    struct TaskQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<TaskQueue> queues;
+    size_t next_queue = 0;
+
+    bool popOwn(unsigned w, function<void()> &task) {
+        lock_guard<mutex> guard(this->queues[w].lock);
+        if (this->queues[w].tasks.empty()) return false;
+        task = std::move(this->queues[w].tasks.back());
+        this->queues[w].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned w, function<void()> &task) {
+        for (size_t i = 1; i < this->queues.size(); ++i) {
+            TaskQueue &victim = this->queues[(w + i) % this->queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void work(unsigned w) {
+        function<void()> task;
+        while (popOwn(w, task) || steal(w, task)) {
+            task();
+        }
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_THREAD_POOL_H
@@ -0,0 +1,112 @@
+#ifndef CS3210_ASSIGNMENT1_TIMING_WHEEL_H
+#define CS3210_ASSIGNMENT1_TIMING_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+/* Hierarchical timing wheel keyed by absolute tick.
+ *
+ * Level k holds entries whose tick first differs from now in its k-th byte, in the slot given by that
+ * byte. Lower levels therefore always hold earlier ticks, level 0 slots hold exactly one tick each, and
+ * an entry is re-filed at most once per level on its way down. With 8 levels of 256 slots every 64 bit
+ * tick fits, so there is no overflow list. */
+class TimingWheel {
+public:
+    TimingWheel() {
+        this->now = 0;
+        this->count = 0;
+        for (unsigned k = 0; k < LEVELS; ++k) {
+            for (unsigned w = 0; w < WORDS; ++w) this->nonempty[k][w] = 0;
+        }
+    }
+
+    uint64_t currentTick() const {
+        return this->now;
+    }
+
+    bool empty() const {
+        return this->count == 0;
+    }
+
+    // tick must not be earlier than currentTick()
+    void schedule(uint64_t tick, uint32_t item) {
+        unsigned k = levelOf(tick);
+        unsigned s = slotOf(tick, k);
+        this->slots[k][s].push_back({tick, item});
+        this->nonempty[k][s / 64] |= 1ull << (s % 64);
+        this->count++;
+    }
+
+    // Earliest scheduled tick, UINT64_MAX when nothing is scheduled.
+    uint64_t nextTick() const {
+        for (unsigned k = 0; k < LEVELS; ++k) {
+            int s = firstSlot(k);
+            if (s < 0) continue;
+            if (k == 0) return (this->now & ~(uint64_t)(SLOTS - 1)) | (uint64_t)s;
+            uint64_t best = UINT64_MAX;
+            for (const Entry &e: this->slots[k][s]) best = e.tick < best ? e.tick : best;
+            return best;
+        }
+        return UINT64_MAX;
+    }
+
+    // Moves now forward, tick must not be later than nextTick().
+    void advanceTo(uint64_t tick) {
+        this->now = tick;
+        for (unsigned k = LEVELS - 1; k > 0; --k) {
+            unsigned s = slotOf(tick, k);
+            if (!(this->nonempty[k][s / 64] & (1ull << (s % 64)))) continue;
+
+            // the slot now covers the current tick, file its entries into the lower levels
+            vector<Entry> moving;
+            moving.swap(this->slots[k][s]);
+            this->nonempty[k][s / 64] &= ~(1ull << (s % 64));
+            this->count -= moving.size();
+            for (const Entry &e: moving) schedule(e.tick, e.item);
+        }
+    }
+
+    // Removes and returns everything scheduled for currentTick().
+    void popDue(vector<uint32_t> &out) {
+        unsigned s = slotOf(this->now, 0);
+        for (const Entry &e: this->slots[0][s]) out.push_back(e.item);
+        this->count -= this->slots[0][s].size();
+        this->slots[0][s].clear();
+        this->nonempty[0][s / 64] &= ~(1ull << (s % 64));
+    }
+
+private:
+    static const unsigned BITS = 8;
+    static const unsigned SLOTS = 1u << BITS;
+    static const unsigned LEVELS = 64 / BITS;
+    static const unsigned WORDS = SLOTS / 64;
+
+    struct Entry {
+        uint64_t tick;
+        uint32_t item;
+    };
+
+    uint64_t now;
+    size_t count;
+    vector<Entry> slots[LEVELS][SLOTS];
+    uint64_t nonempty[LEVELS][WORDS];        // bitmap of slots holding entries
+
+    unsigned levelOf(uint64_t tick) const {
+        uint64_t diff = tick ^ this->now;
+        return diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / BITS;
+    }
+
+    static unsigned slotOf(uint64_t tick, unsigned k) {
+        return (tick >> (k * BITS)) & (SLOTS - 1);
+    }
+
+    int firstSlot(unsigned k) const {
+        for (unsigned w = 0; w < WORDS; ++w) {
+            if (this->nonempty[k][w]) return w * 64 + __builtin_ctzll(this->nonempty[k][w]);
+        }
+        return -1;
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_TIMING_WHEEL_H
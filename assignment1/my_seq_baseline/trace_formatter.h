@@ -0,0 +1,251 @@
+#ifndef CS3210_ASSIGNMENT1_TRACE_FORMATTER_H
+#define CS3210_ASSIGNMENT1_TRACE_FORMATTER_H
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+/* Allocation-free writer for the per-tick position lines.
+ *
+ * Every piece of text a tick line can contain is rendered once up front: "g12-" for each train,
+ * "changi" for each station and "changi->tampines" for each link. Printing a tick is then a handful of
+ * memcpy calls into one large reusable buffer, which goes out with a single write() whenever it fills
+ * up instead of a flush per line.
+ *
+ * The write() itself runs on a writer thread owned by the formatter. A full buffer is swapped with a
+ * spare one the writer has already emptied, so the simulation thread only waits when the writer is
+ * still busy with the previous buffer, i.e. when the output is slower than the simulation. Buffers
+ * are written in the order they fill up, and flush() returns once everything is written. After a
+ * failed write (a full disk, a closed pipe) nothing more is handed off and writeError() tells the
+ * caller, which decides what a truncated trace means for its run. */
+
+// Pre-rendered text pieces, packed into one character pool.
+class FragmentTable {
+public:
+    uint32_t add(const string &text) {
+        this->offsets.push_back(this->pool.size());
+        this->pool.insert(this->pool.end(), text.begin(), text.end());
+        this->ends.push_back(this->pool.size());
+        return this->offsets.size() - 1;
+    }
+
+    size_t size() const {
+        return this->offsets.size();
+    }
+
+    const char *data(uint32_t id) const {
+        return this->pool.data() + this->offsets[id];
+    }
+
+    uint32_t length(uint32_t id) const {
+        return this->ends[id] - this->offsets[id];
+    }
+
+private:
+    vector<char> pool;
+    vector<uint32_t> offsets;
+    vector<uint32_t> ends;
+};
+
+struct TraceFragments {
+    FragmentTable trains;       // "g12-" by global train id
+    FragmentTable stations;     // "changi" by station id
+    FragmentTable links;        // "changi->tampines" by link id
+};
+
+class TraceFormatter {
+public:
+    // fd < 0 keeps everything in memory, see bytes()
+    TraceFormatter(const TraceFragments &fragments, int fd, size_t capacity = 1 << 20) : fragments(fragments) {
+        this->fd = fd;
+        this->capacity = capacity;
+        this->flush_ns = 0;
+        this->handed_off = 0;
+        this->writing = false;
+        this->stopping = false;
+        this->write_errno = 0;
+        this->write_error = 0;
+        this->buf.reserve(capacity + 4096);
+        if (fd >= 0) {
+            this->spare.reserve(capacity + 4096);
+            this->writer = thread([this] { writeLoop(); });
+        }
+    }
+
+    ~TraceFormatter() {
+        flush();
+        if (this->writer.joinable()) {
+            {
+                lock_guard<mutex> guard(this->lock);
+                this->stopping = true;
+            }
+            this->wake.notify_all();
+            this->writer.join();
+        }
+    }
+
+    void beginTick(uint64_t tick) {
+        char digits[20];
+        unsigned n = 0;
+        do {
+            digits[n++] = '0' + tick % 10;
+            tick /= 10;
+        } while (tick > 0);
+        while (n > 0) this->buf.push_back(digits[--n]);
+        this->buf.push_back(':');
+        this->buf.push_back(' ');
+    }
+
+    void trainAtStation(uint32_t train, uint32_t station) {
+        append(this->fragments.trains, train);
+        append(this->fragments.stations, station);
+        this->buf.push_back(' ');
+    }
+
+    void trainOnLink(uint32_t train, uint32_t link) {
+        append(this->fragments.trains, train);
+        append(this->fragments.links, link);
+        this->buf.push_back(' ');
+    }
+
+    void appendBytes(const char *data, size_t len) {
+        this->buf.insert(this->buf.end(), data, data + len);
+    }
+
+    // the separator after the last train (or after the colon) becomes the line break
+    void endTick() {
+        this->buf.back() = '\n';
+        spill();
+    }
+
+    // hands the buffer to the writer once it is full; only call between ticks
+    void spill() {
+        if (this->fd >= 0 && this->buf.size() >= this->capacity) handOff(false);
+    }
+
+    // Returns once everything formatted so far has been written.
+    void flush() {
+        if (this->fd < 0) return;
+        handOff(true);
+    }
+
+    // errno of the first failed write seen by the last hand-off, 0 if none; check it after flush()
+    int writeError() const {
+        return this->write_error;
+    }
+
+    // total time the formatting thread spent waiting for the writer, once per full buffer
+    uint64_t flushNanos() const {
+        return this->flush_ns;
+    }
+
+    // bytes formatted so far, written or not
+    uint64_t position() const {
+        return this->handed_off + this->buf.size();
+    }
+
+    const char *bytes() const {
+        return this->buf.data();
+    }
+
+    size_t size() const {
+        return this->buf.size();
+    }
+
+private:
+    const TraceFragments &fragments;
+    int fd;
+    size_t capacity;
+    vector<char> buf;
+    uint64_t flush_ns;
+    uint64_t handed_off;
+    int write_error;                    // write_errno as of the last hand-off
+
+    /* writer thread begin */
+    thread writer;
+    mutex lock;
+    condition_variable wake;            // the writer has work or should stop
+    condition_variable done;            // the writer emptied its buffer
+    vector<char> spare;                 // being written while `writing`, empty otherwise
+    bool writing;
+    bool stopping;
+    int write_errno;                    // set by the writer when a write failed, 0 otherwise
+    /* writer thread end */
+
+    // Gives the filled buffer to the writer once it is done with the previous one, or drops it once a
+    // write has failed.
+    void handOff(bool wait_written) {
+        struct timespec before, after;
+        clock_gettime(CLOCK_MONOTONIC, &before);
+        unique_lock<mutex> guard(this->lock);
+        this->done.wait(guard, [this] { return !this->writing; });
+        this->write_error = this->write_errno;
+        this->handed_off += this->buf.size();
+        if (this->write_error != 0) {
+            this->buf.clear();
+        } else if (!this->buf.empty()) {
+            this->buf.swap(this->spare);
+            this->writing = true;
+            this->wake.notify_one();
+            if (wait_written) {
+                this->done.wait(guard, [this] { return !this->writing; });
+                this->write_error = this->write_errno;
+            }
+        }
+        guard.unlock();
+        clock_gettime(CLOCK_MONOTONIC, &after);
+        this->flush_ns += (after.tv_sec - before.tv_sec) * 1000000000ll + (after.tv_nsec - before.tv_nsec);
+    }
+
+    void writeLoop() {
+        unique_lock<mutex> guard(this->lock);
+        while (true) {
+            this->wake.wait(guard, [this] { return this->writing || this->stopping; });
+            if (!this->writing) return;
+            guard.unlock();
+            size_t written = 0;
+            int error = 0;
+            while (written < this->spare.size()) {
+                ssize_t n = write(this->fd, this->spare.data() + written, this->spare.size() - written);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    error = n < 0 ? errno : EIO;
+                    break;
+                }
+                written += n;
+            }
+            this->spare.clear();
+            guard.lock();
+            if (error != 0 && this->write_errno == 0) this->write_errno = error;
+            this->writing = false;
+            this->done.notify_all();
+        }
+    }
+
+    void append(const FragmentTable &table, uint32_t id) {
+        const char *p = table.data(id);
+        this->buf.insert(this->buf.end(), p, p + table.length(id));
+    }
+};
+
+// For the single runs printing to stdout: flushes out and ends the process with exit code 2 if any
+// of it could not be written.
+inline void flushOrExit(TraceFormatter &out) {
+    out.flush();
+    if (out.writeError() != 0) {
+        fprintf(stderr, "Failed to write the trace: %s\n", strerror(out.writeError()));
+        exit(2);
+    }
+}
+
+#endif //CS3210_ASSIGNMENT1_TRACE_FORMATTER_H
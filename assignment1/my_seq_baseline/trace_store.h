@@ -0,0 +1,387 @@
+#ifndef CS3210_ASSIGNMENT1_TRACE_STORE_H
+#define CS3210_ASSIGNMENT1_TRACE_STORE_H
+
+#include "delta_trace.h"
+#include <cctype>
+#include <cstdio>
+
+/* Random-access form of a transition trace (delta_trace.h), built once by ./query_trace build and
+ * memory-mapped by every query afterwards.
+ *
+ * The changes are kept in tick order as fixed-size entries, and every `keyframe_changes` changes a
+ * keyframe stores where every train is at that point. The position of any train, or of all of them,
+ * at tick T is the last keyframe at or before T plus the changes up to T, so a query reads one
+ * keyframe and at most keyframe_changes changes. Link usage has its own index: every stay of a train
+ * on a link becomes a visit [enter, leave), grouped by link and sorted by enter. `reach` is the
+ * largest leave of the visits up to and including this one, which is non-decreasing, so the visits
+ * overlapping [from, to] start at a binary search on reach and end where enter passes to.
+ *
+ * Every section starts at a multiple of 8 bytes, at the offset recorded in the header:
+ *   train_end[num_trains] (u64), train pool       as in the transition trace
+ *   train_rank[num_trains] (u32)
+ *   station_end[num_stations] (u64), station pool
+ *   link_end[num_links] (u64), link pool
+ *   link_by_name[num_links] (u32)                 link ids sorted by name
+ *   keyframe_tick[num_keyframes] (u64)            first_tick for the first, empty, keyframe
+ *   keyframe_change[num_keyframes] (u64)          first change not in the keyframe
+ *   keyframe_location[num_keyframes][num_trains] (u32, DELTA_NOWHERE before the train appears)
+ *   changes[num_changes] (StoreChange)
+ *   visit_begin[num_links + 1] (u64)              visits of link l are [visit_begin[l], visit_begin[l + 1])
+ *   visits[num_visits] (StoreVisit) */
+
+#define STORE_MAGIC "MRTSTOR"
+#define STORE_VERSION 1
+
+enum STORE_SECTION {
+    STORE_TRAIN_END,
+    STORE_TRAIN_POOL,
+    STORE_TRAIN_RANK,
+    STORE_STATION_END,
+    STORE_STATION_POOL,
+    STORE_LINK_END,
+    STORE_LINK_POOL,
+    STORE_LINK_BY_NAME,
+    STORE_KEYFRAME_TICK,
+    STORE_KEYFRAME_CHANGE,
+    STORE_KEYFRAME_LOCATION,
+    STORE_CHANGES,
+    STORE_VISIT_BEGIN,
+    STORE_VISITS,
+    NUM_STORE_SECTIONS
+};
+
+struct TraceStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_trains;
+    uint64_t num_stations;
+    uint64_t num_links;
+    uint64_t first_tick;
+    uint64_t end_tick;
+    uint64_t num_changes;
+    uint64_t num_keyframes;
+    uint64_t keyframe_changes;
+    uint64_t num_visits;
+    uint64_t offset[NUM_STORE_SECTIONS];
+    uint64_t bytes[NUM_STORE_SECTIONS];
+};
+
+struct StoreChange {
+    uint64_t tick;
+    uint32_t train;
+    uint32_t location;
+};
+
+struct StoreVisit {
+    uint64_t enter;
+    uint64_t leave;                     // end_tick if the train was still there at the end
+    uint64_t reach;
+    uint32_t train;
+    uint32_t reserved;
+};
+
+/* builder begin */
+class TraceStoreWriter {
+public:
+    explicit TraceStoreWriter(FILE *f) : f(f) {
+        this->ok = true;
+    }
+
+    // Appends a section at the next multiple of 8 bytes and records where it went.
+    void section(TraceStoreHeader &h, STORE_SECTION s, const void *data, uint64_t bytes) {
+        static const char zeros[8] = {0};
+        long at = ftell(this->f);
+        if (at % 8 != 0) this->ok &= fwrite(zeros, 1, 8 - at % 8, this->f) == (size_t)(8 - at % 8);
+        h.offset[s] = ftell(this->f);
+        h.bytes[s] = bytes;
+        if (bytes > 0) this->ok &= fwrite(data, 1, bytes, this->f) == bytes;
+    }
+
+    template<typename T>
+    void section(TraceStoreHeader &h, STORE_SECTION s, const vector<T> &a) {
+        section(h, s, a.data(), a.size() * sizeof(T));
+    }
+
+    void table(TraceStoreHeader &h, STORE_SECTION ends, const FragmentTable &table) {
+        vector<uint64_t> end;
+        string pool;
+        for (uint32_t i = 0; i < table.size(); ++i) {
+            pool.append(table.data(i), table.length(i));
+            end.push_back(pool.size());
+        }
+        section(h, ends, end);
+        section(h, (STORE_SECTION)(ends + 1), pool.data(), pool.size());
+    }
+
+    bool good() const {
+        return this->ok && ferror(this->f) == 0;
+    }
+
+private:
+    FILE *f;
+    bool ok;
+};
+
+// Replays trace into a store at path, with a keyframe every keyframe_changes changes.
+bool buildTraceStore(DeltaTraceReader &trace, const char *path, uint64_t keyframe_changes) {
+    const DeltaTraceHeader &d = trace.header;
+    TraceStoreHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    h.version = STORE_VERSION;
+    h.num_trains = d.num_trains;
+    h.num_stations = d.num_stations;
+    h.num_links = d.num_links;
+    h.first_tick = d.first_tick;
+    h.end_tick = d.end_tick;
+    h.keyframe_changes = keyframe_changes;
+
+    vector<uint32_t> location(d.num_trains, DELTA_NOWHERE), keyframe_location(location);
+    vector<uint64_t> keyframe_tick(1, d.first_tick), keyframe_change(1, 0), entered(d.num_trains);
+    vector<StoreChange> changes;
+    vector<uint32_t> visit_link;
+    vector<StoreVisit> visits;
+    vector<uint32_t> record;
+    uint64_t tick;
+    trace.rewind();
+    while (trace.next(tick, record)) {
+        for (size_t i = 0; i < record.size(); i += 2) {
+            uint32_t id = record[i], now = record[i + 1];
+            if (location[id] != DELTA_NOWHERE && (location[id] & 1)) {
+                visit_link.push_back(location[id] / 2);
+                visits.push_back({entered[id], tick, 0, id, 0});
+            }
+            location[id] = now;
+            entered[id] = tick;
+            changes.push_back({tick, id, now});
+        }
+        if (changes.size() - keyframe_change.back() >= keyframe_changes) {
+            keyframe_tick.push_back(tick);
+            keyframe_change.push_back(changes.size());
+            keyframe_location.insert(keyframe_location.end(), location.begin(), location.end());
+        }
+    }
+    if (!trace.atEnd()) {
+        cerr << "The transition trace has a damaged record\n";
+        return false;
+    }
+    for (uint32_t id = 0; id < d.num_trains; ++id) {
+        if (location[id] != DELTA_NOWHERE && (location[id] & 1)) {
+            visit_link.push_back(location[id] / 2);
+            visits.push_back({entered[id], d.end_tick, 0, id, 0});
+        }
+    }
+
+    // group the visits by link, each link's in enter order
+    vector<uint64_t> visit_begin(d.num_links + 1, 0);
+    for (uint32_t l: visit_link) visit_begin[l + 1]++;
+    for (uint64_t l = 0; l < d.num_links; ++l) visit_begin[l + 1] += visit_begin[l];
+    vector<StoreVisit> by_link(visits.size());
+    vector<uint64_t> fill(visit_begin.begin(), visit_begin.end() - 1);
+    for (size_t v = 0; v < visits.size(); ++v) by_link[fill[visit_link[v]]++] = visits[v];
+    for (uint64_t l = 0; l < d.num_links; ++l) {
+        StoreVisit *begin = by_link.data() + visit_begin[l], *end = by_link.data() + visit_begin[l + 1];
+        sort(begin, end, [](const StoreVisit &a, const StoreVisit &b) {
+            return a.enter < b.enter || (a.enter == b.enter && a.train < b.train);
+        });
+        uint64_t reach = 0;
+        for (StoreVisit *v = begin; v < end; ++v) v->reach = reach = max(reach, v->leave);
+    }
+
+    vector<uint32_t> link_by_name(d.num_links);
+    for (uint32_t l = 0; l < d.num_links; ++l) link_by_name[l] = l;
+    const FragmentTable &links = trace.fragments.links;
+    sort(link_by_name.begin(), link_by_name.end(), [&links](uint32_t a, uint32_t b) {
+        return string(links.data(a), links.length(a)) < string(links.data(b), links.length(b));
+    });
+
+    h.num_changes = changes.size();
+    h.num_keyframes = keyframe_tick.size();
+    h.num_visits = by_link.size();
+
+    FILE *f = fopen(path, "wb");
+    if (f == nullptr) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    TraceStoreWriter out(f);
+    fwrite(&h, sizeof(h), 1, f);        // rewritten below with the offsets
+    out.table(h, STORE_TRAIN_END, trace.fragments.trains);
+    out.section(h, STORE_TRAIN_RANK, trace.train_rank);
+    out.table(h, STORE_STATION_END, trace.fragments.stations);
+    out.table(h, STORE_LINK_END, links);
+    out.section(h, STORE_LINK_BY_NAME, link_by_name);
+    out.section(h, STORE_KEYFRAME_TICK, keyframe_tick);
+    out.section(h, STORE_KEYFRAME_CHANGE, keyframe_change);
+    out.section(h, STORE_KEYFRAME_LOCATION, keyframe_location);
+    out.section(h, STORE_CHANGES, changes);
+    out.section(h, STORE_VISIT_BEGIN, visit_begin);
+    out.section(h, STORE_VISITS, by_link);
+    bool ok = out.good() && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) cerr << "Failed to write " << path << '\n';
+    return ok;
+}
+/* builder end */
+
+class TraceStore {
+public:
+    TraceStoreHeader header;
+
+    bool open(const char *path) {
+        if (!this->file.open(path, MADV_RANDOM)) {
+            cerr << "Failed to open " << path << '\n';
+            return false;
+        }
+        if (this->file.length() < sizeof(this->header)) return bad(path);
+        memcpy(&this->header, this->file.begin(), sizeof(this->header));
+        const TraceStoreHeader &h = this->header;
+        if (memcmp(h.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0) return bad(path);
+        if (h.version != STORE_VERSION) {
+            cerr << path << " has store version " << h.version << ", expected " << STORE_VERSION << '\n';
+            return false;
+        }
+        const uint64_t expected[NUM_STORE_SECTIONS] = {
+                h.num_trains * 8, h.bytes[STORE_TRAIN_POOL], h.num_trains * 4,
+                h.num_stations * 8, h.bytes[STORE_STATION_POOL], h.num_links * 8, h.bytes[STORE_LINK_POOL],
+                h.num_links * 4, h.num_keyframes * 8, h.num_keyframes * 8, h.num_keyframes * h.num_trains * 4,
+                h.num_changes * sizeof(StoreChange), (h.num_links + 1) * 8, h.num_visits * sizeof(StoreVisit)};
+        for (unsigned s = 0; s < NUM_STORE_SECTIONS; ++s) {
+            if (h.bytes[s] != expected[s] || h.offset[s] % 8 != 0 || h.offset[s] > this->file.length()
+                || h.bytes[s] > this->file.length() - h.offset[s]) {
+                return bad(path);
+            }
+        }
+        if (h.num_keyframes == 0) return bad(path);
+        this->train_end = at<uint64_t>(STORE_TRAIN_END);
+        this->train_rank = at<uint32_t>(STORE_TRAIN_RANK);
+        this->link_end = at<uint64_t>(STORE_LINK_END);
+        this->station_end = at<uint64_t>(STORE_STATION_END);
+        this->link_by_name = at<uint32_t>(STORE_LINK_BY_NAME);
+        this->keyframe_tick = at<uint64_t>(STORE_KEYFRAME_TICK);
+        this->keyframe_change = at<uint64_t>(STORE_KEYFRAME_CHANGE);
+        this->keyframe_location = at<uint32_t>(STORE_KEYFRAME_LOCATION);
+        this->changes = at<StoreChange>(STORE_CHANGES);
+        this->visit_begin = at<uint64_t>(STORE_VISIT_BEGIN);
+        this->visits = at<StoreVisit>(STORE_VISITS);
+        return true;
+    }
+
+    // "g12-", the piece printed before the location
+    string trainName(uint32_t id) const {
+        return piece(STORE_TRAIN_POOL, this->train_end, id);
+    }
+
+    // "g12"
+    string trainLabel(uint32_t id) const {
+        string name = trainName(id);
+        if (!name.empty() && name.back() == '-') name.pop_back();
+        return name;
+    }
+
+    uint32_t trainRank(uint32_t id) const {
+        return this->train_rank[id];
+    }
+
+    // "changi" or "changi->tampines"
+    string locationName(uint32_t location) const {
+        return location & 1 ? piece(STORE_LINK_POOL, this->link_end, location / 2)
+                            : piece(STORE_STATION_POOL, this->station_end, location / 2);
+    }
+
+    // Train id of "g12" (or "g12-"): the id is the trailing number, the name must match it.
+    uint32_t findTrain(string name) const {
+        if (name.empty() || name.back() != '-') name.push_back('-');
+        size_t digits = name.size() - 1;
+        while (digits > 0 && isdigit((unsigned char)name[digits - 1])) --digits;
+        if (digits == name.size() - 1 || name.size() - digits > 11) return DELTA_NOWHERE;
+        uint64_t id = strtoull(name.c_str() + digits, nullptr, 10);
+        return id < this->header.num_trains && trainName(id) == name ? id : DELTA_NOWHERE;
+    }
+
+    uint32_t findLink(const string &name) const {
+        const uint32_t *end = this->link_by_name + this->header.num_links;
+        const uint32_t *it = lower_bound(this->link_by_name, end, name, [this](uint32_t l, const string &n) {
+            return piece(STORE_LINK_POOL, this->link_end, l) < n;
+        });
+        return it != end && piece(STORE_LINK_POOL, this->link_end, *it) == name ? *it : DELTA_NOWHERE;
+    }
+
+    // Where the train is shown at tick, DELTA_NOWHERE before it appears or outside the recorded ticks.
+    uint32_t locationAt(uint32_t train, uint64_t tick) const {
+        if (tick < this->header.first_tick || tick >= this->header.end_tick) return DELTA_NOWHERE;
+        uint64_t k = keyframeAt(tick);
+        uint32_t location = this->keyframe_location[k * this->header.num_trains + train];
+        for (uint64_t c = this->keyframe_change[k]; c < this->header.num_changes && this->changes[c].tick <= tick; ++c) {
+            if (this->changes[c].train == train) location = this->changes[c].location;
+        }
+        return location;
+    }
+
+    // Every train's location at tick, as locationAt().
+    void stateAt(uint64_t tick, vector<uint32_t> &location) const {
+        location.assign(this->header.num_trains, DELTA_NOWHERE);
+        if (tick < this->header.first_tick || tick >= this->header.end_tick) return;
+        uint64_t k = keyframeAt(tick);
+        const uint32_t *key = this->keyframe_location + k * this->header.num_trains;
+        location.assign(key, key + this->header.num_trains);
+        for (uint64_t c = this->keyframe_change[k]; c < this->header.num_changes && this->changes[c].tick <= tick; ++c) {
+            location[this->changes[c].train] = this->changes[c].location;
+        }
+    }
+
+    pair<const StoreVisit *, const StoreVisit *> visitsOf(uint32_t link) const {
+        return {this->visits + this->visit_begin[link], this->visits + this->visit_begin[link + 1]};
+    }
+
+    // Visits of link overlapping the ticks [from, to], in enter order.
+    void linkVisits(uint32_t link, uint64_t from, uint64_t to, vector<const StoreVisit *> &found) const {
+        found.clear();
+        pair<const StoreVisit *, const StoreVisit *> all = visitsOf(link);
+        const StoreVisit *v = partition_point(all.first, all.second, [from](const StoreVisit &a) {
+            return a.reach <= from;
+        });
+        for (; v < all.second && v->enter <= to; ++v) {
+            if (v->leave > from) found.push_back(v);
+        }
+    }
+
+private:
+    MappedFile file;
+    const uint64_t *train_end;
+    const uint32_t *train_rank;
+    const uint64_t *station_end;
+    const uint64_t *link_end;
+    const uint32_t *link_by_name;
+    const uint64_t *keyframe_tick;
+    const uint64_t *keyframe_change;
+    const uint32_t *keyframe_location;
+    const StoreChange *changes;
+    const uint64_t *visit_begin;
+    const StoreVisit *visits;
+
+    bool bad(const char *path) {
+        cerr << path << " is not a trace store\n";
+        return false;
+    }
+
+    template<typename T>
+    const T *at(STORE_SECTION s) const {
+        return (const T *)(this->file.begin() + this->header.offset[s]);
+    }
+
+    string piece(STORE_SECTION pool, const uint64_t *ends, uint32_t i) const {
+        uint64_t begin = i == 0 ? 0 : ends[i - 1], end = ends[i];
+        if (begin > end || end > this->header.bytes[pool]) return string();
+        return string(at<char>(pool) + begin, end - begin);
+    }
+
+    // last keyframe at or before tick
+    uint64_t keyframeAt(uint64_t tick) const {
+        const uint64_t *end = this->keyframe_tick + this->header.num_keyframes;
+        return upper_bound(this->keyframe_tick, end, tick) - this->keyframe_tick - 1;
+    }
+};
+
+#endif //CS3210_ASSIGNMENT1_TRACE_STORE_H
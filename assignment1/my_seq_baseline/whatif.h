@@ -0,0 +1,307 @@
+#ifndef CS3210_ASSIGNMENT1_WHATIF_H
+#define CS3210_ASSIGNMENT1_WHATIF_H
+
+#include "soa_engine.h"
+#include "checkpoint.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* What-if reruns that only simulate the ticks a parameter change can affect.
+ *
+ * A base run (--record-base=DIR) is a plain SoA run that also keeps, every `every` ticks, a checkpoint
+ * DIR/snap<i>, the canonical state digest, the size of the trace printed so far, and which stations
+ * had a platform entered and which links were taken during the next `every` ticks. Popularity is only
+ * read when a platform is entered and distance when a link is taken, so a window that touches none of
+ * the changed stations and links runs exactly as in the base run. The trace goes to DIR/trace and is
+ * then copied to stdout; everything else goes to DIR/index.
+ *
+ * A what-if run (--what-if=DIR) loads the changed input, finds the stations and links whose popularity
+ * or distance differ from the base run, copies the base trace up to the first window using one of them
+ * and resumes from that window's snapshot. Whenever it reaches a snapshot tick in the same state as the
+ * base run (digest first, then the full state), it copies the base trace forward again up to the next
+ * window that uses a changed station or link. */
+
+#define WHATIF_MAGIC "MRTWHAT"
+#define WHATIF_VERSION 1
+
+struct WhatIfHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_stations;
+    uint32_t num_links;
+    uint32_t num_network_lines;
+    uint64_t ticks;
+    uint64_t num_lines;                 // printed ticks
+    uint64_t every;
+    uint64_t num_windows;
+    uint64_t trace_size;
+};
+
+struct WhatIfBase {
+    WhatIfHeader header;
+    vector<uint64_t> wanted;
+    vector<uint32_t> popularity;
+    vector<uint32_t> distance;
+    vector<uint64_t> station_first_use;
+    vector<uint64_t> link_first_use;
+    /* per window begin, window i starts at tick i * every */
+    vector<uint64_t> digest;            // state after i * every ticks
+    vector<uint64_t> trace_offset;      // bytes printed for the ticks before the window
+    vector<uint8_t> used;               // num_stations + num_links flags per window
+    /* per window end */
+};
+
+inline string snapshotPath(const string &dir, size_t window) {
+    return dir + "/snap" + to_string(window);
+}
+
+// Appends bytes [from, to) of the trace file to out.
+bool copyTrace(FILE *trace, uint64_t from, uint64_t to, TraceFormatter &out) {
+    static const size_t CHUNK = 1 << 20;
+    vector<char> chunk(CHUNK);
+    if (fseeko(trace, from, SEEK_SET) != 0) return false;
+    while (from < to) {
+        size_t n = fread(chunk.data(), 1, min<uint64_t>(CHUNK, to - from), trace);
+        if (n == 0) return false;
+        out.appendBytes(chunk.data(), n);
+        out.spill();
+        from += n;
+    }
+    return true;
+}
+
+bool writeWhatIfBase(const string &dir, const WhatIfBase &base) {
+    string path = dir + "/index", tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == nullptr) {
+        cerr << "Failed to open " << tmp << '\n';
+        return false;
+    }
+    bool ok = fwrite(&base.header, sizeof(base.header), 1, f) == 1 && writeArray(f, base.wanted)
+              && writeArray(f, base.popularity) && writeArray(f, base.distance)
+              && writeArray(f, base.station_first_use) && writeArray(f, base.link_first_use)
+              && writeArray(f, base.digest) && writeArray(f, base.trace_offset) && writeArray(f, base.used);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "Failed to write " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool loadWhatIfBase(const string &dir, WhatIfBase &base) {
+    string path = dir + "/index";
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        cerr << "Failed to open " << path << '\n';
+        return false;
+    }
+    WhatIfHeader &h = base.header;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, WHATIF_MAGIC, sizeof(WHATIF_MAGIC)) == 0
+              && h.version == WHATIF_VERSION;
+    size_t flags = ok ? (h.num_stations + h.num_links) * h.num_windows : 0;
+    ok = ok && readArray(f, base.wanted, h.num_network_lines) && readArray(f, base.popularity, h.num_stations)
+         && readArray(f, base.distance, h.num_links) && readArray(f, base.station_first_use, h.num_stations)
+         && readArray(f, base.link_first_use, h.num_links) && readArray(f, base.digest, h.num_windows)
+         && readArray(f, base.trace_offset, h.num_windows) && readArray(f, base.used, flags);
+    fclose(f);
+    if (!ok) cerr << path << " is not a base run index\n";
+    return ok;
+}
+
+// Base run, printing to stdout like simulateSoA.
+bool recordBaseRun(const Network &network, size_t ticks, const vector<size_t> &wanted, size_t num_lines,
+                   const string &dir, size_t every) {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        cerr << "Failed to create " << dir << '\n';
+        return false;
+    }
+    string trace_path = dir + "/trace";
+    int fd = open(trace_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Failed to open " << trace_path << '\n';
+        return false;
+    }
+
+    SoATopology topo(network);
+    SoAEngine engine(topo);
+    const size_t S = topo.station_popularity.size(), L = topo.link_distance.size();
+    UsageMarks usage;
+    usage.station.assign(S, USAGE_NONE);
+    usage.link.assign(L, USAGE_NONE);
+    engine.trackUsage(&usage);
+
+    WhatIfBase base;
+    WhatIfHeader &h = base.header;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, WHATIF_MAGIC, sizeof(WHATIF_MAGIC));
+    h.version = WHATIF_VERSION;
+    h.num_stations = S;
+    h.num_links = L;
+    h.num_network_lines = topo.numLines();
+    h.ticks = ticks;
+    h.num_lines = num_lines;
+    h.every = every;
+    base.wanted.assign(wanted.begin(), wanted.end());
+    base.popularity = topo.station_popularity;
+    base.distance = topo.link_distance;
+    base.station_first_use.assign(S, USAGE_NONE);
+    base.link_first_use.assign(L, USAGE_NONE);
+
+    // moves the marks of the window that just ended into its flags
+    auto closeWindow = [&]() {
+        for (size_t s = 0; s < S; ++s) {
+            base.used.push_back(usage.station[s] != USAGE_NONE);
+            base.station_first_use[s] = min(base.station_first_use[s], usage.station[s]);
+            usage.station[s] = USAGE_NONE;
+        }
+        for (size_t l = 0; l < L; ++l) {
+            base.used.push_back(usage.link[l] != USAGE_NONE);
+            base.link_first_use[l] = min(base.link_first_use[l], usage.link[l]);
+            usage.link[l] = USAGE_NONE;
+        }
+    };
+
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    const size_t print_from = num_lines <= ticks ? ticks - num_lines : ticks;
+    bool ok = true;
+    {
+        TraceFormatter out(fragments, fd);
+        for (size_t tick = 0; tick < ticks && ok; ++tick) {
+            if (tick % every == 0) {
+                if (tick > 0) closeWindow();
+                base.digest.push_back(engine.canonicalDigest());
+                base.trace_offset.push_back(out.position());
+                ok = saveCheckpoint(snapshotPath(dir, base.digest.size() - 1), engine, topo, tick, wanted);
+            }
+            usage.tick = tick;
+            engine.spawnTick(wanted);
+            engine.step();
+            if (tick >= print_from) {    // print info
+                engine.writeTick(tick, out);
+            }
+        }
+        if (ticks > 0) closeWindow();
+        out.flush();
+        if (out.writeError() != 0) {
+            cerr << "Failed to write " << trace_path << ": " << strerror(out.writeError()) << '\n';
+            ok = false;
+        }
+        h.trace_size = out.position();
+    }
+    h.num_windows = base.digest.size();
+    ok = ok && writeWhatIfBase(dir, base);
+
+    FILE *trace = fdopen(fd, "rb");
+    if (ok) {
+        TraceFormatter out(fragments, STDOUT_FILENO);
+        ok = copyTrace(trace, 0, h.trace_size, out);
+        flushOrExit(out);
+    }
+    fclose(trace);
+    return ok;
+}
+
+// What-if run against a base run of the same input with some popularities and distances changed.
+bool runWhatIf(const Network &network, size_t ticks, const vector<size_t> &wanted, size_t num_lines,
+               const string &dir) {
+    WhatIfBase base;
+    if (!loadWhatIfBase(dir, base)) return false;
+    SoATopology topo(network);
+    const WhatIfHeader &h = base.header;
+    const size_t S = topo.station_popularity.size(), L = topo.link_distance.size();
+    if (h.num_stations != S || h.num_links != L || h.num_network_lines != topo.numLines() || h.ticks != ticks
+        || h.num_lines != num_lines || !equal(base.wanted.begin(), base.wanted.end(), wanted.begin())) {
+        cerr << dir << " was recorded for another network, N, train counts or number of printed lines\n";
+        return false;
+    }
+
+    vector<uint32_t> changed;           // flag indices: stations, then links offset by S
+    uint64_t first_use = USAGE_NONE;
+    for (size_t s = 0; s < S; ++s) {
+        if (topo.station_popularity[s] == base.popularity[s]) continue;
+        changed.push_back(s);
+        first_use = min(first_use, base.station_first_use[s]);
+    }
+    for (size_t l = 0; l < L; ++l) {
+        if (topo.link_distance[l] == base.distance[l]) continue;
+        changed.push_back(S + l);
+        first_use = min(first_use, base.link_first_use[l]);
+    }
+    // first window from `from` on that touches a changed station or link
+    auto nextAffected = [&](size_t from) {
+        for (size_t w = from; w < h.num_windows; ++w) {
+            for (uint32_t c: changed) {
+                if (base.used[w * (S + L) + c]) return w;
+            }
+        }
+        return (size_t)h.num_windows;
+    };
+
+    string trace_path = dir + "/trace";
+    FILE *trace = fopen(trace_path.c_str(), "rb");
+    if (trace == nullptr) {
+        cerr << "Failed to open " << trace_path << '\n';
+        return false;
+    }
+    TraceFragments fragments;
+    makeTraceFragments(network, wanted, fragments);
+    TraceFormatter out(fragments, STDOUT_FILENO);
+    const size_t print_from = num_lines <= ticks ? ticks - num_lines : ticks;
+    SoAEngine engine(topo);
+    SoAEngine reference(topo);
+    SoASnapshot base_state;
+    uint64_t tick = ticks, simulated = 0;
+    bool ok = true;
+
+    // copies the base trace from window `from` up to window `to` and resumes there
+    auto jump = [&](size_t from, size_t to) {
+        uint64_t end = to < h.num_windows ? base.trace_offset[to] : h.trace_size;
+        ok = copyTrace(trace, from < h.num_windows ? base.trace_offset[from] : 0, end, out);
+        if (ok && to < h.num_windows) {
+            ok = loadCheckpoint(snapshotPath(dir, to), engine, topo, wanted, tick);
+        } else {
+            tick = ticks;
+        }
+    };
+
+    size_t restart = nextAffected(0);
+    jump(h.num_windows, restart);
+    while (ok && tick < ticks) {
+        engine.spawnTick(wanted);
+        engine.step();
+        if (tick >= print_from) {    // print info
+            engine.writeTick(tick, out);
+        }
+        tick++;
+        simulated++;
+        if (tick % h.every != 0 || tick >= ticks) continue;
+
+        size_t w = tick / h.every;
+        uint64_t unused;
+        if (engine.canonicalDigest() != base.digest[w]) continue;
+        ok = loadCheckpoint(snapshotPath(dir, w), reference, topo, wanted, unused);
+        reference.saveState(base_state);
+        if (ok && engine.sameState(base_state)) {
+            size_t next = nextAffected(w);
+            if (next > w) jump(w, next);
+        }
+    }
+    fclose(trace);
+    flushOrExit(out);
+
+    if (changed.empty()) {
+        fprintf(stderr, "what-if: nothing differs from the base run\n");
+    } else if (first_use == USAGE_NONE) {
+        fprintf(stderr, "what-if: no train uses the %zu changed stations and links\n", changed.size());
+    } else {
+        fprintf(stderr, "what-if: %zu changed stations and links, first used at tick %llu, resumed from tick %llu,"
+                        " simulated %llu of %zu ticks\n", changed.size(), (unsigned long long)first_use,
+                (unsigned long long)(restart * h.every), (unsigned long long)simulated, ticks);
+    }
+    return ok;
+}
+
+#endif //CS3210_ASSIGNMENT1_WHATIF_H